@@ -0,0 +1,60 @@
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "camerapath.h"
+
+std::vector<CameraKey> orbit_path(const CameraKey &start, const int frames, const double degrees)
+{
+    std::vector<CameraKey> path;
+    const vec3f offset = start.eye - start.target;
+    for (int i = 0; i < frames; i++) {
+        const double a = degrees * M_PI / 180 * i / frames;
+        const double c = std::cos(a), s = std::sin(a);
+        const vec3f rotated(offset.x * c + offset.z * s, offset.y, -offset.x * s + offset.z * c);
+        path.push_back(CameraKey{start.target + rotated, start.target});
+    }
+    return path;
+}
+
+bool load_camera_path(const std::string &filename, std::vector<CameraKey> &keys)
+{
+    std::ifstream in(filename);
+    if (!in) {
+        std::cerr << "can't open camera path " << filename << std::endl;
+        return false;
+    }
+    std::string line;
+    for (int n = 1; std::getline(in, line); n++) {
+        const size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') continue;
+        std::istringstream iss(line);
+        CameraKey k;
+        if (!(iss >> k.eye.x >> k.eye.y >> k.eye.z >> k.target.x >> k.target.y >> k.target.z)) {
+            std::cerr << filename << ":" << n << ": expected \"ex ey ez tx ty tz\"" << std::endl;
+            return false;
+        }
+        keys.push_back(k);
+    }
+    if (keys.empty()) {
+        std::cerr << "camera path " << filename << " has no keys" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::vector<CameraKey> sample_path(const std::vector<CameraKey> &keys, const int frames)
+{
+    std::vector<CameraKey> path;
+    if (keys.empty()) return path;
+    for (int i = 0; i < frames; i++) {
+        // position along the keys, the first frame is on the first key and the last one on the last key
+        const double t = frames > 1 ? static_cast<double>(i) * (keys.size() - 1) / (frames - 1) : 0;
+        const size_t k = std::min(static_cast<size_t>(t), keys.size() - 1);
+        const size_t k1 = std::min(k + 1, keys.size() - 1);
+        const double f = t - k;
+        path.push_back(CameraKey{keys[k].eye + (keys[k1].eye - keys[k].eye) * f,
+                                 keys[k].target + (keys[k1].target - keys[k].target) * f});
+    }
+    return path;
+}
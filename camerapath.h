@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "geometry.h"
+
+// Where the camera sits and what it looks at for one frame
+struct CameraKey
+{
+    vec3f eye;
+    vec3f target;
+};
+
+/*
+    Camera paths for sequence renders
+
+    --> orbit_path() circles the eye around the target's vertical axis, keeping its height and distance,
+        frame i is rotated by degrees*i/frames so a 360 degree orbit loops without a duplicate frame
+    --> keyframe files hold one key per line, "ex ey ez tx ty tz" (blank lines and lines starting with # are
+        skipped), sample_path() spreads n frames evenly over them and interpolates eye and target linearly
+*/
+std::vector<CameraKey> orbit_path(const CameraKey &start, const int frames, const double degrees = 360);
+bool load_camera_path(const std::string &filename, std::vector<CameraKey> &keys);
+std::vector<CameraKey> sample_path(const std::vector<CameraKey> &keys, const int frames);
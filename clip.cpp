@@ -0,0 +1,119 @@
+#include "clip.h"
+#include <algorithm>
+#include <cmath>
+
+// Signed distance like value of p to a plane, >= 0 inside. p is already in the w > 0 convention
+static double plane_distance(const unsigned plane, const vec4f &p, const ClipParams &params)
+{
+    switch (plane) {
+    case CLIP_NEAR: return p[3] - params.w_near;
+    case CLIP_FAR: return params.w_far - p[3];
+    case GUARD_LEFT: return p[0] + params.guard * p[3];
+    case GUARD_RIGHT: return params.guard * p[3] - p[0];
+    case GUARD_BOTTOM: return p[1] + params.guard * p[3];
+    case GUARD_TOP: return params.guard * p[3] - p[1];
+    }
+    return 0;
+}
+
+static vec4f oriented(const vec4f &pos, const ClipParams &params)
+{
+    return params.negative_w ? pos * -1.0 : pos;
+}
+
+unsigned clip_outcode(const vec4f &pos, const ClipParams &params)
+{
+    const vec4f p = oriented(pos, params);
+    const double gw = params.guard * p[3];
+    unsigned code = 0;
+    if (p[0] < -p[3]) code |= CLIP_LEFT;
+    if (p[0] > p[3]) code |= CLIP_RIGHT;
+    if (p[1] < -p[3]) code |= CLIP_BOTTOM;
+    if (p[1] > p[3]) code |= CLIP_TOP;
+    if (p[3] < params.w_near) code |= CLIP_NEAR;
+    if (p[3] > params.w_far) code |= CLIP_FAR;
+    if (p[0] < -gw) code |= GUARD_LEFT;
+    if (p[0] > gw) code |= GUARD_RIGHT;
+    if (p[1] < -gw) code |= GUARD_BOTTOM;
+    if (p[1] > gw) code |= GUARD_TOP;
+    return code;
+}
+
+unsigned box_outcode(const vec3f &lo, const vec3f &hi, const mat4 &mvp, const ClipParams &params, unsigned &any_out)
+{
+    unsigned all_out = ~0u;
+    any_out = 0;
+    for (int i = 0; i < 8; i++) {
+        const vec3f corner(i & 1 ? hi.x : lo.x, i & 2 ? hi.y : lo.y, i & 4 ? hi.z : lo.z);
+        const unsigned code = clip_outcode(mvp * embed<4>(corner), params);
+        all_out &= code;
+        any_out |= code;
+    }
+    return all_out;
+}
+
+/*
+	--> each plane is a linear function of the model space point, made of the (oriented) rows of mvp : x >= -w is
+		row 3 + row 0 and so on, near and far are row 3 against w_near and w_far. The sphere is outside when its
+		center is more than radius behind one of them, measured with the plane's normal length
+*/
+bool sphere_outside(const vec3f &center, const double radius, const mat4 &mvp, const ClipParams &params)
+{
+    const double s = params.negative_w ? -1 : 1;
+    double row[4][4];
+    for (int r = 0; r < 4; r++)
+        for (int c = 0; c < 4; c++) row[r][c] = s * mvp[r][c];
+
+    auto behind = [&](const double a, const double b, const double c, const double d) {
+        const double dist = a * center.x + b * center.y + c * center.z + d;
+        return dist < -radius * std::sqrt(a * a + b * b + c * c);
+    };
+    const double *w = row[3];
+    for (int k = 0; k < 2; k++) {
+        const double *x = row[k];
+        if (behind(w[0] + x[0], w[1] + x[1], w[2] + x[2], w[3] + x[3])) return true;
+        if (behind(w[0] - x[0], w[1] - x[1], w[2] - x[2], w[3] - x[3])) return true;
+    }
+    return behind(w[0], w[1], w[2], w[3] - params.w_near) || behind(-w[0], -w[1], -w[2], params.w_far - w[3]);
+}
+
+static ClipVertex lerp(const ClipVertex &a, const ClipVertex &b, const double t)
+{
+    return ClipVertex{a.pos + (b.pos - a.pos) * t, a.uv + (b.uv - a.uv) * t};
+}
+
+/*
+	--> Sutherland-Hodgman, one plane at a time between two small polygon buffers
+	--> the intersection is always computed from the inside vertex towards the outside one, so an edge shared by two
+		triangles gets exactly the same new vertex from both sides and no cracks open up along it
+	--> attributes are interpolated linearly in clip space, which is perspective correct at the new vertices
+*/
+int clip_polygon(const ClipVertex in[3], const unsigned planes, const ClipParams &params,
+                 ClipVertex out[clip_max_vertices])
+{
+    static const unsigned order[clip_planes] = {CLIP_NEAR, CLIP_FAR, GUARD_LEFT, GUARD_RIGHT, GUARD_BOTTOM, GUARD_TOP};
+
+    ClipVertex tmp[clip_max_vertices];
+    std::copy(in, in + 3, out);
+    int n = 3;
+
+    for (const unsigned plane : order) {
+        if (!(planes & plane)) continue;
+
+        std::copy(out, out + n, tmp);
+        double d[clip_max_vertices];
+        for (int i = 0; i < n; i++) d[i] = plane_distance(plane, oriented(tmp[i].pos, params), params);
+
+        int m = 0;
+        for (int i = 0; i < n; i++) {
+            const int j = (i + 1) % n;
+            const bool in_i = d[i] >= 0, in_j = d[j] >= 0;
+            if (in_i) out[m++] = tmp[i];
+            if (in_i && !in_j) out[m++] = lerp(tmp[i], tmp[j], d[i] / (d[i] - d[j]));
+            if (!in_i && in_j) out[m++] = lerp(tmp[j], tmp[i], d[j] / (d[j] - d[i]));
+        }
+        n = m;
+        if (n < 3) return 0;
+    }
+    return n;
+}
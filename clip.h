@@ -0,0 +1,69 @@
+#pragma once
+#include <cmath>
+#include "geometry.h"
+
+/*
+	Clip stage in homogeneous coordinates, between the vertex stage and triangle setup
+
+	--> positions are clip space (before the perspective division). The planes are tested on w > 0 in front of the
+		camera, render()'s projection puts w = z_view < 0 in front so it sets negative_w and the clipper looks at
+		-(x,y,z,w) instead, which is the same point after the division
+	--> near and far are planes on w (the view depth), x and y are tested against the view frustum |x| <= w for
+		rejection and against a wider guard band |x| <= guard*w for clipping. There is no far plane unless w_far
+		is set : anything beyond it would be lost to the picture, not just to the depth range
+	--> a triangle completely outside one frustum plane is rejected, one inside the near/far planes and the guard
+		band is passed through untouched (the raster bbox is clamped to the screen anyway, so the parts outside the
+		viewport but inside the band cost nothing). Only what is left is clipped, which in a normal frame is a
+		handful of triangles crossing the near plane or coming very close to the camera
+	--> clipping turns the triangle into a convex polygon of up to 3 + clip_planes vertices, it is fanned back into
+		triangles so one input gives zero or more triangles
+*/
+
+enum ClipBits : unsigned
+{
+    CLIP_LEFT = 1 << 0,
+    CLIP_RIGHT = 1 << 1,
+    CLIP_BOTTOM = 1 << 2,
+    CLIP_TOP = 1 << 3,
+    CLIP_NEAR = 1 << 4,
+    CLIP_FAR = 1 << 5,
+    GUARD_LEFT = 1 << 6,
+    GUARD_RIGHT = 1 << 7,
+    GUARD_BOTTOM = 1 << 8,
+    GUARD_TOP = 1 << 9,
+
+    CLIP_FRUSTUM = CLIP_LEFT | CLIP_RIGHT | CLIP_BOTTOM | CLIP_TOP | CLIP_NEAR | CLIP_FAR,  // rejection
+    CLIP_NEEDED = CLIP_NEAR | CLIP_FAR | GUARD_LEFT | GUARD_RIGHT | GUARD_BOTTOM | GUARD_TOP  // clipping
+};
+
+struct ClipParams
+{
+    double w_near = 1, w_far = HUGE_VAL;  // view depth of the near and far planes
+    double guard = 4;                     // guard band half size in multiples of the viewport half size
+    bool negative_w = false;              // the projection puts w < 0 in front of the camera
+};
+
+struct ClipVertex
+{
+    vec4f pos;  // clip space
+    vec2f uv;
+};
+
+const int clip_planes = 6;                           // near, far and the 4 guard band planes
+const int clip_max_vertices = 3 + clip_planes;       // every plane adds at most one vertex to a convex polygon
+const int clip_max_triangles = clip_max_vertices - 2;
+
+// ClipBits of the planes `pos` is outside of
+unsigned clip_outcode(const vec4f &pos, const ClipParams &params);
+
+// ClipBits every corner of box lo..hi is outside of once through mvp, any_out gets those of at least one corner.
+// A box is culled when the result has a CLIP_FRUSTUM bit and lies completely inside when any_out has none
+unsigned box_outcode(const vec3f &lo, const vec3f &hi, const mat4 &mvp, const ClipParams &params, unsigned &any_out);
+
+// true when the sphere, through mvp, lies completely outside one of the frustum's planes
+bool sphere_outside(const vec3f &center, const double radius, const mat4 &mvp, const ClipParams &params);
+
+// Clips triangle `in` against the planes in `planes` (a ClipBits mask, normally the union of the corner outcodes)
+// and writes the resulting convex polygon to `out`, returns its vertex count, 0 when nothing is left
+int clip_polygon(const ClipVertex in[3], const unsigned planes, const ClipParams &params,
+                 ClipVertex out[clip_max_vertices]);
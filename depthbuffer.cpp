@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include "depthbuffer.h"
+
+DepthBuffer::DepthBuffer(const int width, const int height, const Format format, const double znear,
+                         const double zfar)
+    : width_(width), height_(height), format_(format), znear_(znear),
+      data_(static_cast<size_t>(width) * height * bytes_per_pixel(format)),
+      hiz_(this, width, height)
+{
+    max_ = format == UNORM24 ? double((1 << 24) - 1) : (format == UNORM16 ? 65535. : 0.);
+    scale_ = format == FLOAT32 ? 1. : max_ / (zfar - znear);
+    clear();
+}
+
+bool parse_depth_format(const std::string &name, DepthBuffer::Format &format)
+{
+    if (name == "float32") format = DepthBuffer::FLOAT32;
+    else if (name == "unorm24") format = DepthBuffer::UNORM24;
+    else if (name == "unorm16") format = DepthBuffer::UNORM16;
+    else return false;
+    return true;
+}
+
+size_t DepthBuffer::bytes_per_pixel(const Format format) { return format == UNORM16 ? 2 : 4; }
+
+double DepthBuffer::clear_value() const
+{
+    return format_ == FLOAT32 ? -std::numeric_limits<float>::max() : 0.;
+}
+
+template <typename T>
+static double min_of(const T *p, const int width, const int x0, const int y0, const int x1, const int y1)
+{
+    T m = p[x0 + y0 * width];
+    for (int y = y0; y < y1; y++)
+        for (int x = x0; x < x1; x++) m = std::min(m, p[x + y * width]);
+    return m;
+}
+
+double DepthBuffer::min_encoded(const int x0, const int y0, const int x1, const int y1) const
+{
+    switch (format_) {
+        case FLOAT32: return min_of(data<float>(), width_, x0, y0, x1, y1);
+        case UNORM24: return min_of(data<std::uint32_t>(), width_, x0, y0, x1, y1);
+        default: return min_of(data<std::uint16_t>(), width_, x0, y0, x1, y1);
+    }
+}
+
+double DepthBuffer::encoded(const int x, const int y) const
+{
+    const size_t i = x + static_cast<size_t>(y) * width_;
+    switch (format_) {
+        case FLOAT32: return data<float>()[i];
+        case UNORM24: return data<std::uint32_t>()[i];
+        default: return data<std::uint16_t>()[i];
+    }
+}
+
+double DepthBuffer::get(const int x, const int y) const
+{
+    const double e = encoded(x, y);
+    return format_ == FLOAT32 ? e : e / scale_ + znear_;
+}
+
+void DepthBuffer::clear()
+{
+    // the unorm formats clear to 0, which is a plain memset. float clears to the lowest float, one 32 bit pattern
+    if (format_ == FLOAT32) {
+        float *p = data<float>();
+        std::fill(p, p + static_cast<size_t>(width_) * height_, -std::numeric_limits<float>::max());
+    } else {
+        memset(data_.data(), 0, data_.size());
+    }
+    hiz_.clear(clear_value());
+}
+
+void DepthBuffer::clear(const int x0, const int y0, const int x1, const int y1)
+{
+    const size_t bpp = bytes_per_pixel(format_);
+    for (int y = y0; y < y1; y++) {
+        const size_t row = x0 + static_cast<size_t>(y) * width_;
+        if (format_ == FLOAT32) {
+            float *p = data<float>() + row;
+            std::fill(p, p + (x1 - x0), -std::numeric_limits<float>::max());
+        } else {
+            memset(data_.data() + row * bpp, 0, (x1 - x0) * bpp);
+        }
+    }
+    hiz_.clear(clear_value(), x0, y0, x1, y1);
+}
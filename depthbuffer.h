@@ -0,0 +1,91 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "hiz.h"
+
+/*
+	Depth buffer with selectable storage
+
+	--> FLOAT32 : 4 bytes per pixel, stores depth as is
+	--> UNORM24 : 24 bit unsigned normalized depth in the low bits of a 32 bit word (the usual D24X8 layout, keeps
+		every pixel aligned so the SIMD kernels can load 8 of them at once)
+	--> UNORM16 : 16 bit unsigned normalized depth, a quarter of the old double buffer
+	--> the unorm formats map [znear,zfar] to [0,max], depths outside are clamped. The kernels store truncated
+		integer depths in [0,255] and 255 divides both 2^16-1 and 2^24-1, so with the default range every format
+		stores them exactly
+	--> code 0 is what clear() leaves and bigger wins strictly, so a fragment is never encoded below 1 : depths
+		that would round to 0 (z < 0.5/scale, the truncated depth 0 and everything below znear) share code 1 with
+		the depths just above them instead of losing to the clear, ties between them go to the first one drawn
+	--> so every format renders the same image as FLOAT32 while depths stay inside [znear,zfar]. Outside they
+		clamp and tie the same way : render()'s projection puts surfaces closer than ~1.2 view units above 255
+
+	All comparisons happen on encoded values (encode() is monotonic), as in the old buffer bigger wins. The coarse
+	8x8 level lives here too and works on encoded values as well.
+*/
+class DepthBuffer
+{
+public:
+    enum Format
+    {
+        FLOAT32,
+        UNORM24,
+        UNORM16
+    };
+
+private:
+    int width_{}, height_{};
+    Format format_;
+    double znear_{}, scale_{}, max_{};
+    std::vector<std::uint8_t> data_;
+    HiZBuffer hiz_;
+
+public:
+    DepthBuffer(const int width, const int height, const Format format = FLOAT32,
+                const double znear = 0, const double zfar = 255);
+    DepthBuffer(const DepthBuffer &) = delete;
+    DepthBuffer &operator=(const DepthBuffer &) = delete;
+
+    static size_t bytes_per_pixel(const Format format);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    Format format() const { return format_; }
+    HiZBuffer &hiz() { return hiz_; }
+
+    // raw storage, T must match the format (float, uint32_t or uint16_t)
+    template <typename T> T *data() { return reinterpret_cast<T *>(data_.data()); }
+    template <typename T> const T *data() const { return reinterpret_cast<const T *>(data_.data()); }
+
+    // stored value for depth z (as a double), and the value every pixel holds after clear()
+    double encode(const double z) const
+    {
+        if (format_ == FLOAT32) return z;
+        const double e = (z - znear_) * scale_;
+        return std::nearbyint(e < 1 ? 1 : (e > max_ ? max_ : e));
+    }
+    double clear_value() const;
+    // the encode() parameters, for kernels doing the same math on several pixels at once
+    double znear() const { return znear_; }
+    double scale() const { return scale_; }
+    double max_encoded() const { return max_; }
+    double lowest_encoded() const { return 1; }  // smallest code of a fragment, above clear_value()
+
+    double encoded(const int x, const int y) const;
+    double get(const int x, const int y) const;  // decoded depth
+    double min_encoded(const int x0, const int y0, const int x1, const int y1) const;  // half open rect
+
+    void clear();
+    // half open rect whose corners are on the coarse level's blocks, e.g. one tile of a tiled pass clearing its
+    // own pixels right before drawing them, while they're going to be in cache anyway
+    void clear(const int x0, const int y0, const int x1, const int y1);
+};
+
+bool parse_depth_format(const std::string &name, DepthBuffer::Format &format);  // "float32", "unorm24" or "unorm16"
+
+// Storage type of every format
+template <DepthBuffer::Format F> struct DepthStorage;
+template <> struct DepthStorage<DepthBuffer::FLOAT32> { using type = float; };
+template <> struct DepthStorage<DepthBuffer::UNORM24> { using type = std::uint32_t; };
+template <> struct DepthStorage<DepthBuffer::UNORM16> { using type = std::uint16_t; };
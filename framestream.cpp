@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include "framestream.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define STREAM_SIMD 1
+#include <immintrin.h>
+#else
+#define STREAM_SIMD 0
+#endif
+
+namespace
+{
+
+// BT.601 studio range in 8 bit fixed point
+inline std::uint8_t luma(const int b, const int g, const int r) { return ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16; }
+inline std::uint8_t chroma_b(const int b, const int g, const int r) { return ((112 * b - 74 * g - 38 * r + 128) >> 8) + 128; }
+inline std::uint8_t chroma_r(const int b, const int g, const int r) { return ((-18 * b - 94 * g + 112 * r + 128) >> 8) + 128; }
+inline int avg(const int a, const int b) { return (a + b + 1) >> 1; }  // what pavgb does
+
+// channel c (0 b, 1 g, 2 r) of pixel x, grayscale pixels are their own b, g and r
+inline int channel(const std::uint8_t *row, const int bpp, const int x, const int c)
+{
+    return row[x * bpp + (bpp == 1 ? 0 : c)];
+}
+
+void rgb_row_scalar(const std::uint8_t *src, const int bpp, std::uint8_t *dst, int x, const int n)
+{
+    for (; x < n; x++) {
+        dst[x * 3 + 0] = channel(src, bpp, x, 2);
+        dst[x * 3 + 1] = channel(src, bpp, x, 1);
+        dst[x * 3 + 2] = channel(src, bpp, x, 0);
+    }
+}
+
+void luma_row_scalar(const std::uint8_t *src, const int bpp, std::uint8_t *dst, int x, const int n)
+{
+    for (; x < n; x++) dst[x] = luma(channel(src, bpp, x, 0), channel(src, bpp, x, 1), channel(src, bpp, x, 2));
+}
+
+// chroma of the 2x2 blocks starting at pixel 2*cx of rows r0 and r1, an odd last column repeats itself
+void chroma_row_scalar(const std::uint8_t *r0, const std::uint8_t *r1, const int bpp, std::uint8_t *cb,
+                       std::uint8_t *cr, int cx, const int width)
+{
+    for (; 2 * cx < width; cx++) {
+        const int x0 = 2 * cx, x1 = std::min(x0 + 1, width - 1);
+        int c[3];
+        for (int i = 0; i < 3; i++)
+            c[i] = avg(avg(channel(r0, bpp, x0, i), channel(r1, bpp, x0, i)),
+                       avg(channel(r0, bpp, x1, i), channel(r1, bpp, x1, i)));
+        cb[cx] = chroma_b(c[0], c[1], c[2]);
+        cr[cx] = chroma_r(c[0], c[1], c[2]);
+    }
+}
+
+#if STREAM_SIMD
+
+bool detect_ssse3()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("ssse3");
+}
+
+const bool has_ssse3 = detect_ssse3();
+
+// 4 pixels as bgrx, a 3 byte row needs 16 readable bytes from p so callers stop 2 pixels early
+__attribute__((target("ssse3"))) inline __m128i load4(const std::uint8_t *p, const int bpp)
+{
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    if (bpp == 4) return v;
+    return _mm_shuffle_epi8(v, _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1));
+}
+
+inline int simd_end(const int n, const int bpp) { return bpp == 4 ? n - n % 4 : std::max(0, n - 2) / 4 * 4; }
+
+// returns the first pixel left for the scalar code
+__attribute__((target("ssse3"))) int rgb_row_ssse3(const std::uint8_t *src, const int bpp, std::uint8_t *dst,
+                                                  const int n)
+{
+    if (bpp == 1) return 0;
+    const int end = simd_end(n, bpp);
+    const __m128i to_rgb = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    int x = 0;
+    for (; x < end; x += 4) {
+        const __m128i rgb = _mm_shuffle_epi8(load4(src + x * bpp, bpp), to_rgb);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + x * 3), rgb);
+        const int tail = _mm_cvtsi128_si32(_mm_srli_si128(rgb, 8));
+        std::memcpy(dst + x * 3 + 8, &tail, 4);
+    }
+    return x;
+}
+
+__attribute__((target("ssse3"))) int luma_row_ssse3(const std::uint8_t *src, const int bpp, std::uint8_t *dst,
+                                                   const int n)
+{
+    if (bpp == 1) return 0;
+    const int end = simd_end(n, bpp);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i coef = _mm_setr_epi16(25, 129, 66, 0, 25, 129, 66, 0);
+    const __m128i round = _mm_set1_epi32(128), offset = _mm_set1_epi32(16);
+    int x = 0;
+    for (; x < end; x += 4) {
+        const __m128i p = load4(src + x * bpp, bpp);
+        const __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(p, zero), coef);
+        const __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(p, zero), coef);
+        __m128i y = _mm_hadd_epi32(lo, hi);  // b*25+g*129+r*66 of the 4 pixels
+        y = _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(y, round), 8), offset);
+        y = _mm_packus_epi16(_mm_packs_epi32(y, zero), zero);
+        const int packed = _mm_cvtsi128_si32(y);
+        std::memcpy(dst + x, &packed, 4);
+    }
+    return x;
+}
+
+// 4 pixels of both rows make 2 chroma samples per step, returns the first chroma column left
+__attribute__((target("ssse3"))) int chroma_row_ssse3(const std::uint8_t *r0, const std::uint8_t *r1, const int bpp,
+                                                     std::uint8_t *cb, std::uint8_t *cr, const int width)
+{
+    if (bpp == 1) return 0;
+    const int end = simd_end(width, bpp);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i coef_b = _mm_setr_epi16(112, -74, -38, 0, 112, -74, -38, 0);
+    const __m128i coef_r = _mm_setr_epi16(-18, -94, 112, 0, -18, -94, 112, 0);
+    const __m128i round = _mm_set1_epi32(128);
+    int x = 0;
+    for (; x < end; x += 4) {
+        const __m128i v = _mm_avg_epu8(load4(r0 + x * bpp, bpp), load4(r1 + x * bpp, bpp));
+        const __m128i h = _mm_avg_epu8(v, _mm_srli_epi64(v, 32));  // blocks in pixels 0 and 2
+        const __m128i p = _mm_unpacklo_epi8(_mm_shuffle_epi32(h, _MM_SHUFFLE(3, 1, 2, 0)), zero);
+        __m128i c = _mm_hadd_epi32(_mm_madd_epi16(p, coef_b), _mm_madd_epi16(p, coef_r));  // cb0 cb1 cr0 cr1
+        c = _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(c, round), 8), round);
+        c = _mm_packus_epi16(_mm_packs_epi32(c, zero), zero);
+        const int packed = _mm_cvtsi128_si32(c);
+        cb[x / 2] = packed & 0xff;
+        cb[x / 2 + 1] = packed >> 8 & 0xff;
+        cr[x / 2] = packed >> 16 & 0xff;
+        cr[x / 2 + 1] = packed >> 24 & 0xff;
+    }
+    return x / 2;
+}
+
+#endif
+
+void rgb_row(const std::uint8_t *src, const int bpp, std::uint8_t *dst, const int n)
+{
+    int x = 0;
+#if STREAM_SIMD
+    if (has_ssse3) x = rgb_row_ssse3(src, bpp, dst, n);
+#endif
+    rgb_row_scalar(src, bpp, dst, x, n);
+}
+
+void luma_row(const std::uint8_t *src, const int bpp, std::uint8_t *dst, const int n)
+{
+    int x = 0;
+#if STREAM_SIMD
+    if (has_ssse3) x = luma_row_ssse3(src, bpp, dst, n);
+#endif
+    luma_row_scalar(src, bpp, dst, x, n);
+}
+
+void chroma_row(const std::uint8_t *r0, const std::uint8_t *r1, const int bpp, std::uint8_t *cb, std::uint8_t *cr,
+                const int width)
+{
+    int cx = 0;
+#if STREAM_SIMD
+    if (has_ssse3) cx = chroma_row_ssse3(r0, r1, bpp, cb, cr, width);
+#endif
+    chroma_row_scalar(r0, r1, bpp, cb, cr, cx, width);
+}
+
+}  // namespace
+
+bool parse_stream_format(const std::string &name, FrameStream::Format &format)
+{
+    if (name == "ppm") format = FrameStream::PPM;
+    else if (name == "y4m") format = FrameStream::Y4M;
+    else return false;
+    return true;
+}
+
+FrameStream::FrameStream(const std::string &target, const Format format, const int fps)
+    : format_(format), fps_(fps)
+{
+    if (target == "-") {
+        fd_ = STDOUT_FILENO;
+        return;
+    }
+    fd_ = open(target.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    owns_fd_ = fd_ >= 0;
+    if (fd_ < 0) std::cerr << "can't open stream " << target << "\n";
+}
+
+FrameStream::~FrameStream()
+{
+    if (owns_fd_) close(fd_);
+}
+
+bool FrameStream::write_all(const std::uint8_t *p, size_t n)
+{
+    while (n) {
+        const ssize_t done = ::write(fd_, p, n);
+        if (done < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "can't write to the stream\n";
+            return false;
+        }
+        p += done;
+        n -= done;
+    }
+    return true;
+}
+
+bool FrameStream::write(const TGAImage &image, const bool v_flip)
+{
+    if (fd_ < 0) return false;
+    const int w = static_cast<int>(image.get_width()), h = static_cast<int>(image.get_height());
+    const int bpp = static_cast<int>(image.get_bytespp());
+    if (bpp != 1 && bpp != 3 && bpp != 4) return false;
+
+    std::string header;
+    if (width_ == 0) {
+        width_ = w;
+        height_ = h;
+        if (format_ == Y4M) {
+            header = "YUV4MPEG2 W" + std::to_string(w) + " H" + std::to_string(h) + " F" + std::to_string(fps_) +
+                     ":1 Ip A1:1 C420jpeg\n";
+        }
+    } else if (w != width_ || h != height_) {
+        std::cerr << "stream frames must all be " << width_ << "x" << height_ << "\n";
+        return false;
+    }
+    header += format_ == PPM ? "P6\n" + std::to_string(w) + " " + std::to_string(h) + "\n255\n" : "FRAME\n";
+
+    const std::uint8_t *pixels = image.buffer();
+    auto row = [&](const int y) { return pixels + static_cast<size_t>(v_flip ? h - 1 - y : y) * w * bpp; };
+
+    const size_t cw = (w + 1) / 2, ch = (h + 1) / 2;
+    const size_t payload = format_ == PPM ? static_cast<size_t>(w) * h * 3 : static_cast<size_t>(w) * h + 2 * cw * ch;
+    frame_.resize(header.size() + payload);
+    std::memcpy(frame_.data(), header.data(), header.size());
+    std::uint8_t *out = frame_.data() + header.size();
+
+    if (format_ == PPM) {
+        for (int y = 0; y < h; y++) rgb_row(row(y), bpp, out + static_cast<size_t>(y) * w * 3, w);
+    } else {
+        std::uint8_t *cb = out + static_cast<size_t>(w) * h, *cr = cb + cw * ch;
+        for (int y = 0; y < h; y++) luma_row(row(y), bpp, out + static_cast<size_t>(y) * w, w);
+        for (size_t cy = 0; cy < ch; cy++) {
+            const int y0 = static_cast<int>(2 * cy), y1 = std::min(y0 + 1, h - 1);
+            chroma_row(row(y0), row(y1), bpp, cb + cy * cw, cr + cy * cw, w);
+        }
+    }
+    return write_all(frame_.data(), frame_.size());
+}
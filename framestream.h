@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "tgaimage.h"
+
+/*
+    Streams frames as raw video to stdout, a file or a named pipe, for an encoder on the other end
+    (e.g. ffmpeg -f yuv4mpegpipe -i - or -f image2pipe -c:v ppm -i -)
+
+    --> PPM : every frame is a complete binary P6 image, 8 bit RGB
+    --> Y4M : one YUV4MPEG2 stream header (taken from the first frame), then "FRAME\n" and the planar Y, Cb, Cr
+        planes per frame, 4:2:0 with the chroma sample in the middle of each 2x2 block (C420jpeg) and BT.601
+        studio range
+    --> the framebuffer rows are converted in one pass straight into a frame sized buffer (allocated once and
+        reused), with v_flip the rows are read bottom up like write_tga_file does, so the stream shows the same
+        picture as the TGA. Then the frame goes out in as few write calls as the pipe takes
+    --> the conversion works on 4 pixels at a time with SSSE3 shuffles when the cpu has them (picked once at
+        runtime), the scalar code does the tails and everything elsewhere, both give the same bytes
+    --> 1, 3 and 4 byte per pixel images are accepted, all frames of a stream must have the same size
+*/
+class FrameStream
+{
+public:
+    enum Format
+    {
+        PPM,
+        Y4M
+    };
+
+private:
+    int fd_ = -1;
+    bool owns_fd_ = false;
+    Format format_;
+    int fps_;
+    int width_ = 0, height_ = 0;  // set by the first frame
+    std::vector<std::uint8_t> frame_;
+
+    bool write_all(const std::uint8_t *p, size_t n);
+
+public:
+    // target "-" is stdout, anything else is opened for writing (a named pipe blocks until it has a reader)
+    FrameStream(const std::string &target, const Format format, const int fps = 25);
+    ~FrameStream();
+    FrameStream(const FrameStream &) = delete;
+    FrameStream &operator=(const FrameStream &) = delete;
+
+    bool is_open() const { return fd_ >= 0; }
+    bool write(const TGAImage &image, const bool v_flip = true);
+};
+
+bool parse_stream_format(const std::string &name, FrameStream::Format &format);  // "ppm" or "y4m"
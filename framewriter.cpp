@@ -0,0 +1,57 @@
+#include <algorithm>
+#include "framewriter.h"
+
+FrameWriter::FrameWriter(FrameStream *stream) : stream_(stream), thread_(&FrameWriter::loop, this) {}
+
+FrameWriter::~FrameWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+}
+
+void FrameWriter::loop()
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (true) {
+        wake_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (queue_.empty()) return;  // stop_ and nothing left to write
+        Job job = std::move(queue_.front());
+        queue_.pop_front();
+        busy_ = job.image;
+        lock.unlock();
+        const bool ok = stream_ ? stream_->write(*job.image) : job.image->write_tga_file(job.filename);
+        lock.lock();
+        failed_ = failed_ || !ok;
+        busy_ = nullptr;
+        done_.notify_all();
+    }
+}
+
+void FrameWriter::submit(const TGAImage &image, const std::string &filename)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        queue_.push_back(Job{&image, filename});
+    }
+    wake_.notify_one();
+}
+
+void FrameWriter::wait(const TGAImage &image)
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    done_.wait(lock, [&] {
+        return busy_ != &image &&
+               std::none_of(queue_.begin(), queue_.end(), [&](const Job &j) { return j.image == &image; });
+    });
+}
+
+bool FrameWriter::flush()
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    done_.wait(lock, [this] { return queue_.empty() && !busy_; });
+    return !failed_;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "tgaimage.h"
+#include "framestream.h"
+
+/*
+    Writes images to disk on a background thread, so encoding and I/O of one frame overlap the rendering of
+    the next one
+
+    --> submit() only queues the image, the caller must leave it alone until wait() for that image returned
+        (the usual setup is two images used in turn)
+    --> the writer encodes on its own thread without the render pool, a ThreadPool runs one job at a time and
+        the renderer owns it
+    --> given a FrameStream, frames go into the stream in submission order instead of TGA files
+*/
+class FrameWriter
+{
+private:
+    struct Job
+    {
+        const TGAImage *image;
+        std::string filename;
+    };
+
+    std::mutex mtx_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    std::deque<Job> queue_;
+    FrameStream *stream_ = nullptr;
+    const TGAImage *busy_ = nullptr;  // image being written right now
+    bool stop_ = false;
+    bool failed_ = false;
+    std::thread thread_;  // last, it starts running loop() as soon as it is constructed
+
+    void loop();
+
+public:
+    explicit FrameWriter(FrameStream *stream = nullptr);
+    ~FrameWriter();  // finishes the queue first
+    FrameWriter(const FrameWriter &) = delete;
+    FrameWriter &operator=(const FrameWriter &) = delete;
+
+    void submit(const TGAImage &image, const std::string &filename);  // filename is unused when streaming
+    void wait(const TGAImage &image);  // until image is neither queued nor being written
+    bool flush();                      // until the queue is empty, false if any write failed
+};
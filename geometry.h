@@ -1,40 +1,52 @@
 #pragma once
 
+#include <algorithm>
 #include <cmath>
 #include <cassert>
 #include <iostream>
 #include <fstream>
+#include <type_traits>
+
+/*
+    Everything here is templated on the scalar type T (double by default), so vec<n, float> and
+    mat<4, 4, float> are real single precision types all the way through. Scalar arguments use
+    std::type_identity_t<T> so `v * 0.5` works for float vectors without a deduction conflict.
+
+    Most of it is constexpr. The single precision mat4*vec4, mat4*mat4, cross and normalize have SSE
+    overloads further down, in a constant expression they fall back to the plain loops, and
+    simd_matches_generic() checks them against the templates at run time.
+*/
 
 template <size_t n, typename T = double>
 struct vec
 {
-    vec() = default;
-    T& operator[](const size_t i)
+    constexpr vec() = default;
+    constexpr T& operator[](const size_t i)
     {
         assert(i >= 0 && i < n);
         return data[i];
     }
-    T operator[](const size_t i) const
+    constexpr T operator[](const size_t i) const
     {
         assert(i >= 0 && i < n);
         return data[i];
     }
-    T norm2() const { return (*this) * (*this); }
+    constexpr T norm2() const { return dot(*this, *this); }
     T norm() const { return std::sqrt(norm2()); }
     T data[n] = {0};
 };
 
 template <size_t n, typename T = double>
-double dot(const vec<n, T>& lhs, const vec<n, T>& rhs)
+constexpr T dot(const vec<n, T>& lhs, const vec<n, T>& rhs)
 {
-    double ret = 0;
+    T ret = 0;
     for (size_t i = n; i--; ret += lhs[i] * rhs[i])
         ;
     return ret;
 }
 
 template <size_t n, typename T = double>
-vec<n, T> operator+(const vec<n, T>& lhs, const vec<n, T>& rhs)
+constexpr vec<n, T> operator+(const vec<n, T>& lhs, const vec<n, T>& rhs)
 {
     vec<n, T> ret = lhs;
     for (size_t i = n; i--; ret[i] += rhs[i])
@@ -43,7 +55,7 @@ vec<n, T> operator+(const vec<n, T>& lhs, const vec<n, T>& rhs)
 }
 
 template <size_t n, typename T = double>
-vec<n, T> operator-(const vec<n, T>& lhs, const vec<n, T>& rhs)
+constexpr vec<n, T> operator-(const vec<n, T>& lhs, const vec<n, T>& rhs)
 {
     vec<n, T> ret = lhs;
     for (size_t i = n; i--; ret[i] -= rhs[i])
@@ -52,16 +64,16 @@ vec<n, T> operator-(const vec<n, T>& lhs, const vec<n, T>& rhs)
 }
 
 template <size_t n, typename T = double>
-vec<n, T> operator*(const double& rhs, const vec<n, T>& lhs)
+constexpr vec<n, T> operator*(const std::type_identity_t<T>& rhs, const vec<n, T>& lhs)
 {
-    vec<n> ret = lhs;
+    vec<n, T> ret = lhs;
     for (size_t i = n; i--; ret[i] *= rhs)
         ;
     return ret;
 }
 
 template <size_t n, typename T = double>
-vec<n, T> operator*(const vec<n, T>& lhs, const double& rhs)
+constexpr vec<n, T> operator*(const vec<n, T>& lhs, const std::type_identity_t<T>& rhs)
 {
     vec<n, T> ret = lhs;
     for (size_t i = n; i--; ret[i] *= rhs)
@@ -70,7 +82,7 @@ vec<n, T> operator*(const vec<n, T>& lhs, const double& rhs)
 }
 
 template <size_t n, typename T = double>
-vec<n, T> operator/(const vec<n, T>& lhs, const double& rhs)
+constexpr vec<n, T> operator/(const vec<n, T>& lhs, const std::type_identity_t<T>& rhs)
 {
     vec<n, T> ret = lhs;
     for (size_t i = n; i--; ret[i] /= rhs)
@@ -79,7 +91,7 @@ vec<n, T> operator/(const vec<n, T>& lhs, const double& rhs)
 }
 
 template <size_t n1, size_t n2, typename T = double>
-vec<n1, T> embed(const vec<n2, T>& v, double fill = 1)
+constexpr vec<n1, T> embed(const vec<n2, T>& v, const std::type_identity_t<T> fill = 1)
 {
     vec<n1, T> ret;
     for (size_t i = n1; i--; ret[i] = (i < n2 ? v[i] : fill))
@@ -88,7 +100,7 @@ vec<n1, T> embed(const vec<n2, T>& v, double fill = 1)
 }
 
 template <size_t n1, size_t n2, typename T = double>
-vec<n1, T> proj(const vec<n2, T>& v)
+constexpr vec<n1, T> proj(const vec<n2, T>& v)
 {
     vec<n1, T> ret;
     for (size_t i = n1; i--; ret[i] = v[i])
@@ -106,19 +118,19 @@ std::ostream& operator<<(std::ostream& out, const vec<n, T>& v)
 template <typename T>
 struct vec<2, T>
 {
-    vec() = default;
-    vec(T X, T Y) : x(X), y(Y) {}
-    T& operator[](const size_t i)
+    constexpr vec() = default;
+    constexpr vec(T X, T Y) : x(X), y(Y) {}
+    constexpr T& operator[](const size_t i)
     {
         assert(i >= 0 && i < 2);
         return i == 0 ? x : y;
     }
-    T operator[](const size_t i) const
+    constexpr T operator[](const size_t i) const
     {
         assert(i >= 0 && i < 2);
         return i == 0 ? x : y;
     }
-    T norm2() const { 
+    constexpr T norm2() const { 
         return x * x + y * y; }
     T norm() const { return std::sqrt(norm2()); }
     vec& normalize()
@@ -133,79 +145,75 @@ struct vec<2, T>
 template <typename T>
 struct vec<3, T>
 {
-    vec() = default;
-    vec(T X, T Y, T Z) : x(X), y(Y), z(Z) {}
-    T& operator[](const size_t i)
+    constexpr vec() = default;
+    constexpr vec(T X, T Y, T Z) : x(X), y(Y), z(Z) {}
+    constexpr T& operator[](const size_t i)
     {
         assert(i >= 0 && i < 3);
         return i == 0 ? x : (1 == i ? y : z);
     }
-    T operator[](const size_t i) const
+    constexpr T operator[](const size_t i) const
     {
         assert(i >= 0 && i < 3);
         return i == 0 ? x : (1 == i ? y : z);
     }
-    T norm2() const { return dot((*this), (*this)); }
+    constexpr T norm2() const { return dot((*this), (*this)); }
     T norm() const { return std::sqrt(norm2()); }
-    vec& normalize()
-    {
-        *this = (*this) / norm();
-        return *this;
-    }
+    vec& normalize();
 
     T x{}, y{}, z{};
 };
 
-template <size_t n>
+template <size_t n, typename T>
 struct dt;
 
-template <size_t nrows, size_t ncols>
+template <size_t nrows, size_t ncols, typename T = double>
 struct mat
 {
-    vec<ncols, double> rows[nrows] = {{}};
+    vec<ncols, T> rows[nrows] = {{}};
 
-    mat() = default;
-    vec<ncols, double>& operator[](const size_t idx)
+    constexpr mat() = default;
+    constexpr vec<ncols, T>& operator[](const size_t idx)
     {
         assert(idx >= 0 && idx < nrows);
         return rows[idx];
     }
-    const vec<ncols, double>& operator[](const size_t idx) const
+    constexpr const vec<ncols, T>& operator[](const size_t idx) const
     {
         assert(idx >= 0 && idx < nrows);
         return rows[idx];
     }
 
-    vec<nrows, double> col(const size_t idx) const
+    constexpr vec<nrows, T> col(const size_t idx) const
     {
         assert(idx >= 0 && idx < ncols);
-        vec<nrows, double> ret;
+        vec<nrows, T> ret;
         for (size_t i = nrows; i--; ret[i] = rows[i][idx])
             ;
         return ret;
     }
 
-    void set_col(const size_t idx, const vec<nrows, double>& v)
+    constexpr void set_col(const size_t idx, const vec<nrows, T>& v)
     {
         assert(idx >= 0 && idx < ncols);
         for (size_t i = nrows; i--; rows[i][idx] = v[i])
             ;
     }
 
-    static mat<nrows, ncols> identity()
+    static constexpr mat<nrows, ncols, T> identity()
     {
-        mat<nrows, ncols> ret;
+        mat<nrows, ncols, T> ret;
         for (size_t i = nrows; i--;)
             for (size_t j = ncols; j--; ret[i][j] = (i == j))
                 ;
         return ret;
     }
 
-    double det() const { return dt<ncols>::det(*this); }
+    constexpr T det() const { return dt<ncols, T>::det(*this); }
 
-    mat<nrows - 1, ncols - 1> get_minor(const size_t row, const size_t col) const
+    constexpr mat<nrows - 1, ncols - 1, T> get_minor(const size_t row, const size_t col) const
     {
-        mat<nrows - 1, ncols - 1> ret;
+        mat<nrows - 1, ncols - 1, T> ret;
         for (size_t i = nrows - 1; i--;)
             for (size_t j = ncols - 1; j--;
                  ret[i][j] = rows[i < row ? i : i + 1][j < col ? j : j + 1])
@@ -213,117 +221,117 @@ struct mat
         return ret;
     }
 
-    double cofactor(const size_t row, const size_t col) const
+    constexpr T cofactor(const size_t row, const size_t col) const
     {
         return get_minor(row, col).det() * ((row + col) % 2 ? -1 : 1);
     }
 
-    mat<nrows, ncols> adjugate() const
+    constexpr mat<nrows, ncols, T> adjugate() const
     {
-        mat<nrows, ncols> ret;
+        mat<nrows, ncols, T> ret;
         for (size_t i = nrows; i--;)
             for (size_t j = ncols; j--; ret[i][j] = cofactor(i, j))
                 ;
         return ret;
     }
 
-    mat<nrows, ncols> invert_transpose() const
+    constexpr mat<nrows, ncols, T> invert_transpose() const
     {
-        mat<nrows, ncols> ret = adjugate();
+        mat<nrows, ncols, T> ret = adjugate();
         return ret / dot(ret[0], rows[0]);
     }
 
-    mat<nrows, ncols> invert() const { return invert_transpose().transpose(); }
+    constexpr mat<nrows, ncols, T> invert() const { return invert_transpose().transpose(); }
 
-    mat<ncols, nrows> transpose() const
+    constexpr mat<ncols, nrows, T> transpose() const
     {
-        mat<ncols, nrows> ret;
+        mat<ncols, nrows, T> ret;
         for (size_t i = ncols; i--; ret[i] = this->col(i))
             ;
         return ret;
     }
 };
 
-template <size_t nrows, size_t ncols>
-vec<nrows, double> operator*(const mat<nrows, ncols>& lhs, const vec<ncols, double>& rhs)
+template <size_t nrows, size_t ncols, typename T>
+constexpr vec<nrows, T> operator*(const mat<nrows, ncols, T>& lhs, const vec<ncols, T>& rhs)
 {
-    vec<nrows, double> ret;
+    vec<nrows, T> ret;
     for (size_t i = nrows; i--; ret[i] = dot(lhs[i], rhs))
         ;
     return ret;
 }
 
-template <size_t R1, size_t C1, size_t C2>
-mat<R1, C2> operator*(const mat<R1, C1>& lhs, const mat<C1, C2>& rhs)
+template <size_t R1, size_t C1, size_t C2, typename T>
+constexpr mat<R1, C2, T> operator*(const mat<R1, C1, T>& lhs, const mat<C1, C2, T>& rhs)
 {
-    mat<R1, C2> result;
+    mat<R1, C2, T> result;
     for (size_t i = R1; i--;)
         for (size_t j = C2; j--; result[i][j] = dot(lhs[i], rhs.col(j)))
             ;
     return result;
 }
 
-template <size_t nrows, size_t ncols>
-mat<nrows, ncols> operator*(const mat<nrows, ncols>& lhs, const double& val)
+template <size_t nrows, size_t ncols, typename T>
+constexpr mat<nrows, ncols, T> operator*(const mat<nrows, ncols, T>& lhs, const std::type_identity_t<T>& val)
 {
-    mat<nrows, ncols> result;
+    mat<nrows, ncols, T> result;
     for (size_t i = nrows; i--; result[i] = lhs[i] * val)
         ;
     return result;
 }
 
-template <size_t nrows, size_t ncols>
-mat<nrows, ncols> operator/(const mat<nrows, ncols>& lhs, const double& val)
+template <size_t nrows, size_t ncols, typename T>
+constexpr mat<nrows, ncols, T> operator/(const mat<nrows, ncols, T>& lhs, const std::type_identity_t<T>& val)
 {
-    mat<nrows, ncols> result;
+    mat<nrows, ncols, T> result;
     for (size_t i = nrows; i--; result[i] = lhs[i] / val)
         ;
     return result;
 }
 
-template <size_t nrows, size_t ncols>
-mat<nrows, ncols> operator+(const mat<nrows, ncols>& lhs, const mat<nrows, ncols>& rhs)
+template <size_t nrows, size_t ncols, typename T>
+constexpr mat<nrows, ncols, T> operator+(const mat<nrows, ncols, T>& lhs, const mat<nrows, ncols, T>& rhs)
 {
-    mat<nrows, ncols> result;
+    mat<nrows, ncols, T> result;
     for (size_t i = nrows; i--;)
         for (size_t j = ncols; j--; result[i][j] = lhs[i][j] + rhs[i][j])
             ;
     return result;
 }
 
-template <size_t nrows, size_t ncols>
-mat<nrows, ncols> operator-(const mat<nrows, ncols>& lhs, const mat<nrows, ncols>& rhs)
+template <size_t nrows, size_t ncols, typename T>
+constexpr mat<nrows, ncols, T> operator-(const mat<nrows, ncols, T>& lhs, const mat<nrows, ncols, T>& rhs)
 {
-    mat<nrows, ncols> result;
+    mat<nrows, ncols, T> result;
     for (size_t i = nrows; i--;)
         for (size_t j = ncols; j--; result[i][j] = lhs[i][j] - rhs[i][j])
             ;
     return result;
 }
 
-template <size_t nrows, size_t ncols>
-std::ostream& operator<<(std::ostream& out, const mat<nrows, ncols>& m)
+template <size_t nrows, size_t ncols, typename T>
+std::ostream& operator<<(std::ostream& out, const mat<nrows, ncols, T>& m)
 {
     for (size_t i = 0; i < nrows; i++) out << m[i] << std::endl;
     return out;
 }
 
-template <size_t n>
+template <size_t n, typename T>
 struct dt
 {
-    static double det(const mat<n, n>& src)
+    static constexpr T det(const mat<n, n, T>& src)
     {
-        double ret = 0;
+        T ret = 0;
         for (size_t i = n; i--; ret += src[0][i] * src.cofactor(0, i))
             ;
         return ret;
     }
 };
 
-template <>
-struct dt<1>
+template <typename T>
+struct dt<1, T>
 {
-    static double det(const mat<1, 1>& src) { return src[0][0]; }
+    static constexpr T det(const mat<1, 1, T>& src) { return src[0][0]; }
 };
 
 using vec2f = vec<2, double>;
@@ -336,6 +344,12 @@ using vec4i = vec<4, int>;
 
 using mat4 = mat<4, 4>;
 
+// single precision, the "f" aliases above predate these and stay double
+using vec2f32 = vec<2, float>;
+using vec3f32 = vec<3, float>;
+using vec4f32 = vec<4, float>;
+using mat4f32 = mat<4, 4, float>;
+
 inline vec2f to_f(vec2i in) { return vec2f(static_cast<double>(in.x), static_cast<double>(in.y)); }
 inline vec3f to_f(vec3i in)
 {
@@ -343,13 +357,176 @@ inline vec3f to_f(vec3i in)
 }
 inline vec4f to_f(vec4i in)
 {
-    return vec4f{static_cast<double>(in[0]), static_cast<double>(in[1]), static_cast<double>(in[2]),
-                 static_cast<double>(in[3])};
+    vec4f ret;
+    for (size_t i = 4; i--; ret[i] = static_cast<double>(in[i]))
+        ;
+    return ret;
+}
+
+// element wise conversion between scalar types, e.g. cast<float>(mvp) for the single precision paths
+template <typename U, size_t n, typename T>
+constexpr vec<n, U> cast(const vec<n, T>& v)
+{
+    vec<n, U> ret;
+    for (size_t i = n; i--; ret[i] = static_cast<U>(v[i]))
+        ;
+    return ret;
+}
+
+template <typename U, size_t nrows, size_t ncols, typename T>
+constexpr mat<nrows, ncols, U> cast(const mat<nrows, ncols, T>& m)
+{
+    mat<nrows, ncols, U> ret;
+    for (size_t i = nrows; i--; ret[i] = cast<U>(m[i]))
+        ;
+    return ret;
+}
+
+template <typename T>
+constexpr vec<3, T> cross(const vec<3, T>& v1, const vec<3, T>& v2)
+{
+    return vec<3, T>{v1.y * v2.z - v1.z * v2.y, v1.z * v2.x - v1.x * v2.z, v1.x * v2.y - v1.y * v2.x};
 }
 
-inline vec3f cross(const vec3f& v1, const vec3f& v2)
+template <typename T>
+vec<3, T>& vec<3, T>::normalize()
+{
+    *this = (*this) / norm();
+    return *this;
+}
+
+/*
+    SSE versions of the hot single precision operations, 4 floats per register
+    --> mat4*vec4 : multiply every row by the vector, then a 4x4 transpose turns the four horizontal sums
+        into three vertical adds
+    --> mat4*mat4 : row i of the result is sum_k lhs[i][k] * rhs.rows[k], a broadcast and a multiply-add per k
+    --> vec3 cross / normalize : the 3 components padded to one register, cross is two shuffles per operand
+    They are overloads of the generic templates above (a non template overload wins the tie). No SSE3/SSE4
+    instructions are used, SSE is part of every x86-64 cpu.
+*/
+#if defined(__SSE__)
+#include <xmmintrin.h>
+
+constexpr vec4f32 operator*(const mat4f32& lhs, const vec4f32& rhs)
 {
-    return vec3f{v1.y * v2.z - v1.z * v2.y, v1.z * v2.x - v1.x * v2.z, v1.x * v2.y - v1.y * v2.x};
+    if (std::is_constant_evaluated()) {
+        vec4f32 ret;
+        for (size_t i = 4; i--; ret[i] = dot(lhs[i], rhs))
+            ;
+        return ret;
+    }
+    const __m128 v = _mm_loadu_ps(rhs.data);
+    __m128 r0 = _mm_mul_ps(_mm_loadu_ps(lhs[0].data), v);
+    __m128 r1 = _mm_mul_ps(_mm_loadu_ps(lhs[1].data), v);
+    __m128 r2 = _mm_mul_ps(_mm_loadu_ps(lhs[2].data), v);
+    __m128 r3 = _mm_mul_ps(_mm_loadu_ps(lhs[3].data), v);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    vec4f32 ret;
+    _mm_storeu_ps(ret.data, _mm_add_ps(_mm_add_ps(r0, r1), _mm_add_ps(r2, r3)));
+    return ret;
+}
+
+constexpr mat4f32 operator*(const mat4f32& lhs, const mat4f32& rhs)
+{
+    if (std::is_constant_evaluated()) {
+        mat4f32 result;
+        for (size_t i = 4; i--;)
+            for (size_t j = 4; j--; result[i][j] = dot(lhs[i], rhs.col(j)))
+                ;
+        return result;
+    }
+    const __m128 b0 = _mm_loadu_ps(rhs[0].data), b1 = _mm_loadu_ps(rhs[1].data);
+    const __m128 b2 = _mm_loadu_ps(rhs[2].data), b3 = _mm_loadu_ps(rhs[3].data);
+    mat4f32 result;
+    for (size_t i = 0; i < 4; i++) {
+        const vec4f32& a = lhs[i];
+        __m128 r = _mm_mul_ps(_mm_set1_ps(a.data[0]), b0);
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a.data[1]), b1));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a.data[2]), b2));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a.data[3]), b3));
+        _mm_storeu_ps(result[i].data, r);
+    }
+    return result;
+}
+
+constexpr vec3f32 cross(const vec3f32& v1, const vec3f32& v2)
+{
+    if (std::is_constant_evaluated()) {
+        return vec3f32{v1.y * v2.z - v1.z * v2.y, v1.z * v2.x - v1.x * v2.z, v1.x * v2.y - v1.y * v2.x};
+    }
+    const __m128 a = _mm_set_ps(0, v1.z, v1.y, v1.x), b = _mm_set_ps(0, v2.z, v2.y, v2.x);
+    const __m128 a_yzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+    const __m128 b_yzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+    // a x b = (a * b.yzx - a.yzx * b).yzx
+    const __m128 c = _mm_sub_ps(_mm_mul_ps(a, b_yzx), _mm_mul_ps(a_yzx, b));
+    alignas(16) float r[4];
+    _mm_store_ps(r, _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1)));
+    return vec3f32{r[0], r[1], r[2]};
+}
+
+template <>
+inline vec3f32& vec3f32::normalize()
+{
+    const __m128 v = _mm_set_ps(0, z, y, x);
+    __m128 n2 = _mm_mul_ps(v, v);
+    n2 = _mm_add_ps(n2, _mm_shuffle_ps(n2, n2, _MM_SHUFFLE(2, 3, 0, 1)));
+    n2 = _mm_add_ps(n2, _mm_shuffle_ps(n2, n2, _MM_SHUFFLE(1, 0, 3, 2)));
+    alignas(16) float r[4];
+    _mm_store_ps(r, _mm_div_ps(v, _mm_sqrt_ps(n2)));
+    x = r[0];
+    y = r[1];
+    z = r[2];
+    return *this;
+}
+#endif
+
+/*
+    Check of the SSE overloads against the generic templates (called by name with explicit template arguments,
+    which leaves the non template overloads out), on a fixed set of pseudo random inputs in [-2,2]
+    --> cross does the same multiplies and subtracts per component, it has to match exactly
+    --> mat4*vec4, mat4*mat4 and normalize add in a different order, they may differ by a few float ulps of the
+        terms' magnitude, tol is that bound
+    Without SSE there is nothing to compare and it returns true
+*/
+inline bool simd_matches_generic()
+{
+#if defined(__SSE__)
+    unsigned seed = 12345;
+    auto next = [&seed] {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<float>(seed >> 8) / (1 << 23) - 1.0f;  // [-1,1)
+    };
+    auto close = [](const float a, const float b) { return std::abs(a - b) <= 1e-5f * std::max(1.0f, std::abs(b)); };
+
+    for (int round = 0; round < 64; round++) {
+        mat4f32 a, b;
+        vec4f32 v;
+        for (size_t i = 0; i < 4; i++) {
+            for (size_t j = 0; j < 4; j++) {
+                a[i][j] = 2 * next();
+                b[i][j] = 2 * next();
+            }
+            v[i] = 2 * next();
+        }
+        const vec4f32 mv = a * v, mv_ref = operator*<4, 4, float>(a, v);
+        const mat4f32 mm = a * b, mm_ref = operator*<4, 4, 4, float>(a, b);
+        for (size_t i = 0; i < 4; i++) {
+            if (!close(mv[i], mv_ref[i])) return false;
+            for (size_t j = 0; j < 4; j++)
+                if (!close(mm[i][j], mm_ref[i][j])) return false;
+        }
+
+        const vec3f32 p(v[0], v[1], v[2]), q(a[0][0], a[0][1], a[0][2]);
+        const vec3f32 c = cross(p, q), c_ref = cross<float>(p, q);
+        if (c.x != c_ref.x || c.y != c_ref.y || c.z != c_ref.z) return false;
+        if (p.norm() < 1e-3f) continue;
+        vec3f32 n = p;
+        n.normalize();
+        const vec3f32 n_ref = p / p.norm();
+        if (!close(n.x, n_ref.x) || !close(n.y, n_ref.y) || !close(n.z, n_ref.z)) return false;
+    }
+#endif
+    return true;
 }
 
 template <typename T>
@@ -364,4 +541,4 @@ inline void display_vec(vec3f &v){
 
 inline void display_vec(vec4f &v){
 	std::cout << v[0] << " " << v[1] << " " << v[2] << " " << v[3] << std::endl;
-}
\ No newline at end of file
+}
@@ -0,0 +1,40 @@
+#include <algorithm>
+#include "hiz.h"
+#include "depthbuffer.h"
+
+HiZBuffer::HiZBuffer(const DepthBuffer *fine, const int width, const int height)
+    : fine_(fine), width_(width), height_(height), bw_((width + block - 1) / block),
+      bh_((height + block - 1) / block), min_(bw_ * bh_), dirty_(bw_ * bh_, 0)
+{}
+
+void HiZBuffer::clear(const double depth)
+{
+    std::fill(min_.begin(), min_.end(), depth);
+    std::fill(dirty_.begin(), dirty_.end(), 0);
+}
+
+void HiZBuffer::clear(const double depth, const int x0, const int y0, const int x1, const int y1)
+{
+    for (int by = y0 / block; by < (y1 + block - 1) / block; by++) {
+        for (int bx = x0 / block; bx < (x1 + block - 1) / block; bx++) {
+            min_[bx + by * bw_] = depth;
+            dirty_[bx + by * bw_] = 0;
+        }
+    }
+}
+
+bool HiZBuffer::occluded(const int bx, const int by, const double zmax)
+{
+    if (dirty_[bx + by * bw_]) refresh(bx, by);
+    return zmax <= min_[bx + by * bw_];
+}
+
+void HiZBuffer::mark_dirty(const int bx, const int by) { dirty_[bx + by * bw_] = 1; }
+
+void HiZBuffer::refresh(const int bx, const int by)
+{
+    const int x0 = bx * block, x1 = std::min(width_, x0 + block);
+    const int y0 = by * block, y1 = std::min(height_, y0 + block);
+    min_[bx + by * bw_] = fine_->min_encoded(x0, y0, x1, y1);
+    dirty_[bx + by * bw_] = 0;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+class DepthBuffer;
+
+/*
+	Coarse level of the depth buffer
+
+	--> keeps one value per 8x8 block of pixels : the smallest (encoded) depth stored in that block
+	--> depth test here is "bigger z wins" (closer to the camera), so that minimum is a conservative bound, anything
+		whose z over the block is <= it loses the z-test on every pixel of the block and can be skipped before
+		any per pixel work
+	--> depths in the fine buffer only ever grow, so a stale minimum is still conservative. Drawing into a block just
+		marks it dirty and the minimum is recomputed from the fine buffer the next time the block is tested, so a
+		block hit by many triangles in a row is only rescanned once
+	--> blocks never straddle two 64x64 tiles, so the tiled renderer can test and mark them from several threads
+*/
+class HiZBuffer
+{
+private:
+    const DepthBuffer *fine_;
+    int width_{}, height_{};
+    int bw_{}, bh_{};  // size in blocks
+    std::vector<double> min_;
+    std::vector<std::uint8_t> dirty_;
+
+    void refresh(const int bx, const int by);
+
+public:
+    static constexpr int block = 8;
+
+    HiZBuffer(const DepthBuffer *fine, const int width, const int height);
+    void clear(const double depth);
+    void clear(const double depth, const int x0, const int y0, const int x1, const int y1);  // half open, block aligned
+    bool occluded(const int bx, const int by, const double zmax);  // zmax already encoded
+    void mark_dirty(const int bx, const int by);
+};
@@ -0,0 +1,58 @@
+#include "instance.h"
+#include <algorithm>
+#include <cmath>
+
+vec3f Instance::object_dir(const vec3f &dir) const
+{
+    vec3f d = proj<3>(model.invert() * embed<4>(dir, 0));
+    return d.normalize();
+}
+
+bool bbox_visible(const Model &model, const mat4 &mvp, const ClipParams &params)
+{
+    unsigned any_out;
+    return !(box_outcode(model.bbox_min(), model.bbox_max(), mvp, params, any_out) & CLIP_FRUSTUM);
+}
+
+std::vector<Instance> instance_grid(const std::vector<Model *> &models, const int n, const double spacing)
+{
+    std::vector<Instance> instances;
+    if (n <= 0 || models.empty()) return instances;
+    const int cols = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(n))));
+    const double cell = spacing > 0 ? spacing : 2.0 / cols;
+    const double half = spacing > 0 ? cols * cell / 2 : 1;
+
+    instances.reserve(n);
+    for (int i = 0; i < n; i++) {
+        const int cx = i % cols, cy = i / cols;
+        const Model &model = *models[i % models.size()];
+
+        // the model is scaled so its largest extent fits a cell
+        const vec3f size = model.bbox_max() - model.bbox_min();
+        const vec3f center = (model.bbox_min() + model.bbox_max()) * 0.5;
+        const double scale = 0.9 * cell / std::max({size.x, size.y, size.z, 1e-9});
+        // a quarter turn of yaw across the grid, so neighbours show slightly different sides
+        const double yaw = (static_cast<double>(i) / n - 0.5) * M_PI / 2;
+        const double c = std::cos(yaw) * scale, s = std::sin(yaw) * scale;
+
+        Instance inst;
+        inst.mesh = &model;
+        mat4 &m = inst.model;
+        m[0][0] = c;
+        m[0][2] = s;
+        m[1][1] = scale;
+        m[2][0] = -s;
+        m[2][2] = c;
+        const vec3f rc = proj<3>(m * embed<4>(center));
+        m[0][3] = -half + (cx + 0.5) * cell - rc.x;
+        m[1][3] = half - (cy + 0.5) * cell - rc.y;
+        m[2][3] = -rc.z;
+
+        // tints cycle through a few warm and cool shades
+        static const TGAColor palette[6] = {TGAColor(255, 255, 255), TGAColor(255, 200, 170), TGAColor(170, 200, 255),
+                                            TGAColor(200, 255, 190), TGAColor(255, 240, 160), TGAColor(230, 180, 255)};
+        inst.tint = palette[(cx * 7 + cy * 3) % 6];
+        instances.push_back(inst);
+    }
+    return instances;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <vector>
+#include "clip.h"
+#include "geometry.h"
+#include "model.h"
+#include "tgaimage.h"
+
+/*
+	Instances : copies of a Model placed around the world
+
+	--> the mesh (vertices, uvs, textures) stays the Model's and is shared by every instance of it, an instance is
+		a pointer to it, its model matrix and a tint, a couple hundred bytes however large the mesh is
+	--> model matrices are expected to be rotations, uniform scales and translations. Faces are lit in the model's
+		own space, by bringing the light into it once per instance (object_dir()) instead of every face normal
+		out into the world
+	--> an instance whose bbox lies completely outside one plane of the view frustum is dropped before its
+		vertex stage, which is most of what an off screen instance costs otherwise
+	--> instances are drawn as the objects of a Scene (scene.h), which finds the visible ones
+*/
+struct Instance
+{
+    const Model *mesh = nullptr;              // not owned
+    mat4 model = mat4::identity();            // model to world
+    TGAColor tint = TGAColor(255, 255, 255);  // multiplies the shaded color, channel by channel
+
+    // world space direction in the model's space, unit length
+    vec3f object_dir(const vec3f &dir) const;
+};
+
+// false when the model's bbox, through mvp (projection*view*model), is completely outside one frustum plane
+bool bbox_visible(const Model &model, const mat4 &mvp, const ClipParams &params);
+
+// n instances on a square grid in the z = 0 plane around the origin, each scaled down to its cell, turned and tinted
+// a little differently from its neighbours : the crowd --instances draws. Instance i is of models[i % size].
+// Cells are spacing apart, 0 fits the whole grid in [-1,1]x[-1,1]
+std::vector<Instance> instance_grid(const std::vector<Model *> &models, const int n, const double spacing = 0);
@@ -1,9 +1,30 @@
 #include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <tuple>
 #include "tgaimage.h"
 #include "model.h"
 #include "geometry.h"
 #include "triangle.h"
 #include "transform.h"
+#include "tiles.h"
+#include "threadpool.h"
+#include "depthbuffer.h"
+#include "vertex.h"
+#include "clip.h"
+#include "visbuffer.h"
+#include "msaa.h"
+#include "instance.h"
+#include "scene.h"
+#include "shadow.h"
+#include "camerapath.h"
+#include "framewriter.h"
+#include "framestream.h"
 
 
 const TGAColor white = TGAColor(255, 255, 255, 255);
@@ -14,6 +35,11 @@ const TGAColor blue  = TGAColor(0  , 0  , 255, 255);
 const int width = 1200;
 const int height = 1200;
 const int depth = 255;
+DepthBuffer::Format depth_format = DepthBuffer::FLOAT32; // --depth : storage of the depth buffer, the unorm formats take less memory
+bool deferred = false; // --deferred : visibility buffer first, then shade every pixel once
+int msaa = 0; // --msaa : samples per pixel (4 or 8), 0 draws one
+double lod_error = 1; // --lod-error : largest simplification error drawn, in pixels, 0 always draws full detail
+const vec3f sun_dir = vec3f(1,-1,1).normalize(); // --shadows : the light that casts them, the way it travels
 
 
 // vec3f cam(0.8, 0.7, 5.0);
@@ -23,13 +49,29 @@ vec3f cam(0,0,-5);
 vec3f target(0,0,0);
 
 Model* model = NULL;
-double *zbuffer = NULL;
+DepthBuffer* zbuffer = NULL;
+ThreadPool* pool = NULL;
+ShadowMap* shadow_map = NULL;
+std::vector<Model*> models; // every model of the command line, the first one is model
+Scene scene; // --instances or several models : the objects drawn instead of the model alone
+
+//Per frame working memory of render(), kept between frames so a sequence doesn't reallocate it every time
+struct FrameScratch {
+	std::vector<vec3f> screen;
+	std::vector<vec4f> clip;
+	MeshletCull cull; //meshlets of the model being set up that survived culling, and their vertices
+	std::tuple<std::vector<ShadedTriangle<DiffuseShader>>, std::vector<ShadedTriangle<ShadowedShader>>, std::vector<ShadedTriangle<ObjectShader<TintedShader<DiffuseShader>>>>> tris; //one list per shader render() and render_scene() use
+	std::vector<uint32_t> visible; //render_scene() : ids of the objects that passed culling
+	std::vector<const Model*> meshes; //render_scene() : the level of detail drawn of each of them
+	std::vector<TintedShader<DiffuseShader>> object_shaders; //render_scene() : one per visible object, its faces point at it
+	TileBinner binner{width, height};
+	VisibilityBuffer vis{width, height};
+	std::vector<SampleTile> samples; //--msaa : one tile of samples per thread of the pool, made on first use
+};
 
 void INIT_ZBUF(void){
-	zbuffer = new double[width*height];
-	for(int i = width*height ; i >= 0 ; i--){
-		zbuffer[i] = -std::numeric_limits<float>::max();
-	}
+	//depths of the viewport range [0,depth], the buffer starts out cleared
+	zbuffer = new DepthBuffer(width, height, depth_format, 0, depth);
 	return;
 }
 
@@ -38,120 +80,451 @@ vec3i world2screen(vec3f w){
 	return vec3i(int((w.x + 1.0f) * width / 2.0f), int((w.y + 1.0f) * height / 2.0f),w.z);
 }
 
-void untex_render(vec3f light_dir, double *zbuffer, Model *model, TGAImage &image) {
-	mat4 view_port = viewport(width/8,height/8,width*3/4,height*3/4,depth);
-	// mat4 view_port = viewport(0,0,width,height);
-	mat4 proj = mat4::identity();
-	proj[3][2] = 1.0f/cam.z;
-
-	for (size_t i = 0; i < model->nfaces(); i++) {
-		// std::vector<int> face = model->face(i);
-
-		vec3f screen_coords[3];//screen coordinates of triangle associated with ith face
-		vec3f world_coords[3];
-
-		for (size_t j = 0; j < 3; j++) {
-
-			vec3f v = model->vert(i, j); //get the jth vertex of ith face, these have components as just numbers in the range [-1,1]
-
-			//convert them to display on screen , map [-1,1] to [0,width] and [0,height] 
-			screen_coords[j] = embed<3>(view_port*proj*embed<4>(v));
-			world_coords[j] = v;
-		}
-
-		vec3f n = cross(world_coords[2] - world_coords[0], world_coords[1] - world_coords[0]); //calculate normal to triangle
-
-		n.normalize();
-		double intensity = dot(n, light_dir);
-
-		if (intensity > 0) {
-			// TGAColor clr = TGAColor(0,intensity*255,intensity*255);
-			// triangle(screen_coords,zbuffer, image, clr);
-
-			untex_triangle(screen_coords,zbuffer, image, TGAColor(static_cast<uint8_t>(intensity * 255), static_cast<uint8_t>(intensity * 255), static_cast<uint8_t>(intensity * 255)));			
-		}
-	}
+//Clip : near is the front given to projection(), whose w is the view z (negative in front). No far plane, what lies
+//beyond the projection's back is still drawn and only the scene's extent bounds it
+ClipParams camera_clip() {
+	ClipParams clip_params;
+	clip_params.w_near = 1.0;
+	clip_params.negative_w = true;
+	return clip_params;
 }
 
-void render(vec3f light_dir, double *zbuffer, Model *model, TGAImage &image) {
-	
+//Vertex stage of the camera, mvp is projection*view and gets an object's model matrix on its right
+VertexStage camera_stage(const CameraKey &camera) {
 	mat4 view_port = viewport(0,0,width,height,depth);
 	// mat4 view_port = viewport(width/8,height/8,width*3/4,height*3/4);
 
 	mat4 proj = projection(30.0f,static_cast<float>(width/height),-1.0f,-10.0f);
-	mat4 model_view = lookat(cam,target,vec3f(0,1,0));
-
-	for (size_t i = 0; i < model->nfaces(); i++) {
-
-		vec3f screen_coords[3];	//screen coords of triangle associated with ith face
-		vec3f world_coords[3];	//world coords of triangle associated with ith face
-		vec2f uv_coords[3];		//uv coords of vertices of triangle associated with ith face
-
-		for (size_t j = 0; j < 3; j++) {
+	mat4 model_view = lookat(camera.eye,camera.target,vec3f(0,1,0));
+
+	VertexStage vs;
+	vs.mvp = proj*model_view;
+	vs.viewport = view_port;
+	vs.flip_z = true; // z-buffer doesnt work if I don't do this, probably due to how I've implemented the projection matrix
+	vs.single_precision = vertex_single_precision();
+	return vs;
+}
 
-			vec3f v = model->vert(i, j); //get the jth vertex of ith face, these have components as just numbers in the range [-1,1]
+//Starts a frame drawn with shader S : empties its triangle list and the bins
+template <Shader S>
+void begin_frame(FrameScratch &scratch, size_t nfaces) {
+	std::vector<ShadedTriangle<S>> &tris = std::get<std::vector<ShadedTriangle<S>>>(scratch.tris);
+	tris.clear();
+	tris.reserve(nfaces);
+	scratch.binner.clear();
+}
 
-			world_coords[j] = v;
+//Everything between the vertex stage of a model (vs, in scratch.screen and scratch.clip) and the raster : face setup, clipping and binning with shader S
+//only the faces of the meshlets in scratch.cull are looked at, the vertex stage only ran on theirs
+//the survivors are appended to the frame's triangle list in submission order, so several models (or instances) can go into one frame
+template <Shader S>
+void setup_model(const S &shader, const VertexStage &vs, const Model *model, FrameScratch &scratch) {
+	const std::vector<vec3f> &screen = scratch.screen;
+	const std::vector<vec4f> &clip = scratch.clip;
+	const ClipParams clip_params = camera_clip();
+
+	//Setup : cull and set up each face once, keep the survivors in submission order
+	std::vector<ShadedTriangle<S>> &tris = std::get<std::vector<ShadedTriangle<S>>>(scratch.tris);
+	TileBinner &binner = scratch.binner;
+	const double reach = msaa ? 0.5 : 0; //samples lie within half a pixel of the pixel's position
+
+	for (uint32_t id : scratch.cull.meshlets) {
+		const Meshlet &meshlet = model->meshlets()[id];
+		for (size_t i = meshlet.face_begin; i < meshlet.face_end; i++) {
+
+			ShadedTriangle<S> t;
+			if (!shader.vertex(i, t.face)) continue;
+
+			vec3f screen_coords[3];	//screen coords of triangle associated with ith face
+			vec2f uv_coords[3]{};	//uv coords of vertices of triangle associated with ith face
+
+			for (size_t j = 0; j < 3; j++) {
+				screen_coords[j] = screen[model->vert_index(i, j)];
+				if constexpr (S::uses_uv) uv_coords[j] = model->uv(i,j);
+			}
+
+			unsigned all_out = CLIP_FRUSTUM, any_out = 0;
+			for (size_t j = 0; j < 3; j++) {
+				const unsigned code = clip_outcode(clip[model->vert_index(i, j)], clip_params);
+				all_out &= code;
+				any_out |= code;
+			}
+			if (all_out) continue; //completely outside one side of the frustum
+
+			if (!(any_out & CLIP_NEEDED)) {
+				if (!t.setup.init(screen_coords, S::uses_uv ? uv_coords : nullptr, width, height, reach)) continue;
+				binner.bin(tris.size(), t.setup.xmin, t.setup.ymin, t.setup.xmax, t.setup.ymax);
+				tris.push_back(t);
+				continue;
+			}
+
+			//Crosses the near/far plane or leaves the guard band : clip it and fan the polygon back into triangles
+			ClipVertex corners[3], poly[clip_max_vertices];
+			for (size_t j = 0; j < 3; j++) corners[j] = ClipVertex{clip[model->vert_index(i, j)], uv_coords[j]};
+			const int nverts = clip_polygon(corners, any_out & CLIP_NEEDED, clip_params, poly);
+
+			vec3f poly_screen[clip_max_vertices];
+			for (int k = 0; k < nverts; k++) poly_screen[k] = clip_to_screen(vs, poly[k].pos);
+			for (int k = 1; k + 1 < nverts; k++) {
+				const vec3f fan_screen[3] = {poly_screen[0], poly_screen[k], poly_screen[k + 1]};
+				const vec2f fan_uv[3] = {poly[0].uv, poly[k].uv, poly[k + 1].uv};
+				if (!t.setup.init(fan_screen, S::uses_uv ? fan_uv : nullptr, width, height, reach)) continue;
+				binner.bin(tris.size(), t.setup.xmin, t.setup.ymin, t.setup.xmax, t.setup.ymax);
+				tris.push_back(t);
+			}
+		}
+	}
+}
 
-			//MVP Trasnform , here model matrix is Identity because only one object in the scene with no change in oreintation or position
-			auto tmp = proj*model_view*embed<4>(v);
-			
-			//perspective division
-			for(int i = 0 ; i < 4 ; i++){
-				tmp[i] = tmp[i] / tmp[3];	
-			} 
+//Raster of every triangle set up this frame with shader S
+template <Shader S>
+void raster_frame(const S &shader, DepthBuffer &zbuffer, TGAImage &image, ThreadPool &pool, FrameScratch &scratch) {
+	const std::vector<ShadedTriangle<S>> &tris = std::get<std::vector<ShadedTriangle<S>>>(scratch.tris);
+	const TileBinner &binner = scratch.binner;
+
+	//Multisampled : a tile draws into the samples of its thread and resolves them into color and depth once all its triangles are in
+	if (msaa) {
+		while (scratch.samples.size() < pool.size()) scratch.samples.emplace_back(msaa, binner.tile_size());
+		pool.parallel_for(binner.ntiles(), [&](size_t t) {
+			SampleTile &samples = scratch.samples[ThreadPool::worker_index()];
+			samples.begin(binner.tile(t));
+			for (uint32_t id : binner.tris(t)) {
+				draw_triangle_msaa(shader, tris[id].face, tris[id].setup, samples);
+			}
+			samples.resolve(image, zbuffer);
+		});
+		return;
+	}
 
-			tmp = view_port*tmp; 
+	//Raster : tiles own disjoint pieces of the color and depth buffers, so they can be drawn in parallel
+	if (!deferred) {
+		pool.parallel_for(binner.ntiles(), [&](size_t t) {
+			const Tile tile = binner.tile(t);
+			for (uint32_t id : binner.tris(t)) {
+				draw_triangle(shader, tris[id].face, tris[id].setup, zbuffer, image, tile);
+			}
+		});
+		return;
+	}
 
-			screen_coords[j] = embed<3>(tmp);
-			screen_coords[j].z *= -1.0f; // z-buffer doesnt work if I don't do this, probably due to how I've implemented the projection matrix
-			
-			uv_coords[j] = model->uv(i,j);			
+	//Deferred : a tile resolves visibility for all its triangles first and then shades its pixels, while they are still in cache
+	VisibilityBuffer &vis = scratch.vis;
+	pool.parallel_for(binner.ntiles(), [&](size_t t) {
+		const Tile tile = binner.tile(t);
+		vis.clear(tile);
+		for (uint32_t id : binner.tris(t)) {
+			vis.draw(id, tris[id].setup, zbuffer, tile);
 		}
+		shade_visibility(vis, shader, tris.data(), image, tile);
+	});
+}
 
-		//calculate normal to triangle
-		vec3f n = cross(world_coords[2] - world_coords[0], world_coords[1] - world_coords[0]); 
-		n.normalize();
+//One model, alone in the frame
+template <Shader S>
+void draw_model(const S &shader, const VertexStage &vs, DepthBuffer &zbuffer, const Model *model, TGAImage &image, ThreadPool &pool, FrameScratch &scratch) {
+	begin_frame<S>(scratch, scratch.cull.faces);
+	setup_model(shader, vs, model, scratch);
+	raster_frame(shader, zbuffer, image, pool, scratch);
+}
 
-		//Lmabertian lighting
-		double intensity = dot(n, light_dir);
+void render(const CameraKey &camera, vec3f light_dir, DepthBuffer &zbuffer, Model *model, TGAImage &image, ThreadPool &pool, FrameScratch &scratch, const ShadowMap *shadow) {
+
+	//Vertex stage : MVP Trasnform , perspective division and viewport for every vertex of the model, once
+	//here model matrix is Identity, the model sits at the origin of the world (render_scene() places objects elsewhere)
+	//a model far enough away is drawn with one of its simplified levels instead, whatever the level it only walks its own faces
+	//meshlets turned away from the light (the shaders below cull their faces against it) or outside the frustum are dropped first, with their vertices
+	const VertexStage vs = camera_stage(camera);
+	const Model *mesh = &select_lod(*model, vs, lod_error);
+	cull_meshlets(*mesh, light_dir, vs.mvp, camera_clip(), scratch.cull);
+	run_vertex_stage(vs, *mesh, scratch.cull.verts, scratch.screen, pool, &scratch.clip);
+
+	//Textured and unlit, the light only culls faces turned away from it. With a shadow map the pixels it hides from its light are darkened
+	DiffuseShader diffuse{mesh, light_dir};
+	if (shadow) draw_model(ShadowedShader{diffuse, shadow, screen_to_shadow_map(vs, *shadow)}, vs, zbuffer, mesh, image, pool, scratch);
+	else draw_model(diffuse, vs, zbuffer, mesh, image, pool, scratch);
+}
 
-		if (intensity > 0) {
-			triangle(screen_coords,uv_coords,zbuffer,image,model);			
-		}
+/*
+	Scene render : every object of the scene (instances of one or several models, see scene.h) in one frame
+
+	--> the camera's matrices are combined once, the scene's BVH is walked with them and only the objects that may
+		be visible are looked at again, the frame costs what is on screen rather than the size of the scene
+	--> each of those picks its level of detail from how large its simplification error would be on screen, then
+		culls the mesh's meshlets and runs the vertex stage and setup of what is left with its own matrix and its own
+		shader (light in model space, tint), into one triangle list and one set of bins. The raster pass then runs once for all of them, like
+		for a single model
+*/
+void render_scene(const CameraKey &camera, vec3f light_dir, DepthBuffer &zbuffer, const Scene &scene, TGAImage &image, ThreadPool &pool, FrameScratch &scratch) {
+	using Object = TintedShader<DiffuseShader>;
+	const VertexStage camera_vs = camera_stage(camera);
+	scene.cull(camera_vs.mvp, camera_clip(), scratch.visible);
+
+	size_t nfaces = 0;
+	scratch.meshes.clear();
+	for (uint32_t id : scratch.visible) {
+		const Instance &inst = scene.object(id);
+		VertexStage vs = camera_vs;
+		vs.mvp = camera_vs.mvp * inst.model;
+		scratch.meshes.push_back(&select_lod(*inst.mesh, vs, lod_error));
+		nfaces += scratch.meshes.back()->nfaces();
 	}
+	begin_frame<ObjectShader<Object>>(scratch, nfaces);
+
+	//faces point at their object's shader until the raster pass is done, the list must not move
+	scratch.object_shaders.clear();
+	scratch.object_shaders.reserve(scratch.visible.size());
+
+	for (size_t i = 0; i < scratch.visible.size(); i++) {
+		const Instance &inst = scene.object(scratch.visible[i]);
+		const Model *mesh = scratch.meshes[i];
+		VertexStage vs = camera_vs;
+		vs.mvp = camera_vs.mvp * inst.model;
+
+		const vec3f object_light = inst.object_dir(light_dir);
+		cull_meshlets(*mesh, object_light, vs.mvp, camera_clip(), scratch.cull);
+		run_vertex_stage(vs, *mesh, scratch.cull.verts, scratch.screen, pool, &scratch.clip);
+		scratch.object_shaders.push_back(Object{DiffuseShader{mesh, object_light}, inst.tint});
+		setup_model(ObjectShader<Object>{&scratch.object_shaders.back()}, vs, mesh, scratch);
+	}
+	raster_frame(ObjectShader<Object>{}, zbuffer, image, pool, scratch);
+}
 
+//One frame of whatever the command line asked for
+void render_frame(const CameraKey &camera, vec3f light_dir, DepthBuffer &zbuffer, TGAImage &image, ThreadPool &pool, FrameScratch &scratch) {
+	if (scene.size()) render_scene(camera, light_dir, zbuffer, scene, image, pool, scratch);
+	else render(camera, light_dir, zbuffer, model, image, pool, scratch, shadow_map);
+}
+
+void write_depth(DepthBuffer &zbuffer, ThreadPool &pool) {
 	TGAImage depth(width, height, TGAImage::GRAYSCALE);
 	for(size_t h = 0 ; h < height ; h++){
 		for(size_t w = 0 ; w < width ; w++){
-			depth.set(h,w,static_cast<uint8_t>((zbuffer[w * height + h] + 1) * 255));
+			//cleared pixels are black whatever the format stores for them
+			const double z = zbuffer.encoded(h, w) == zbuffer.clear_value() ? -1 : zbuffer.get(h, w);
+			depth.set(h,w,static_cast<uint8_t>((z + 1) * 255));
+		}
+	}
+	depth.write_tga_file("depth.tga", true, true, &pool);
+}
+
+/*
+	Shadow map benchmark : the same map drawn again and again with every raster kernel the cpu has
+
+	--> setup (vertex stage, triangle setup, binning) is done once, only raster() is timed
+	--> the depth only kernels are timed against the flat color kernels drawing the same triangles, which is
+		what a shadow pass would cost without them. The best of N passes is reported
+*/
+void bench_shadow(int passes) {
+	ShadowMap map;
+	map.setup(*model, sun_dir, *pool);
+	TGAImage color(map.size(), map.size(), TGAImage::RGB);
+	std::cout << "shadow map " << map.size() << "x" << map.size() << ", " << map.ntriangles() << " triangles, best of " << passes << " passes\n";
+
+	auto best_ms = [&](TGAImage *target) {
+		double best = 1e30;
+		for (int i = 0; i < passes; i++) {
+			const auto start = std::chrono::steady_clock::now();
+			map.raster(*pool, target);
+			best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
 		}
+		return best;
+	};
+
+	const RasterKernel active = raster_kernel();
+	for (RasterKernel k : {RasterKernel::Scalar, RasterKernel::SSE41, RasterKernel::AVX2}) {
+#if RASTER_SIMD
+		if (k == RasterKernel::SSE41 && !__builtin_cpu_supports("sse4.1")) continue;
+		if (k == RasterKernel::AVX2 && !__builtin_cpu_supports("avx2")) continue;
+#else
+		if (k != RasterKernel::Scalar) continue;
+#endif
+		set_raster_kernel(k);
+		const double depth_only = best_ms(nullptr), with_color = best_ms(&color);
+		std::printf("  %-6s depth only %7.3f ms   color %7.3f ms   %.2fx\n", raster_kernel_name(k), depth_only, with_color, with_color / depth_only);
 	}
-	depth.write_tga_file("depth.tga");
+	set_raster_kernel(active);
+}
+
+void usage(const char *prog) {
+	std::cerr << "usage: " << prog << " [model.obj ...] [--frames N] [--orbit DEGREES] [--path FILE] [--out PREFIX] [--stream ppm|y4m] [--deferred] [--msaa 4|8] [--instances N] [--spacing D] [--lod-error PX] [--depth float32|unorm24|unorm16] [--shadows] [--bench-shadow N]\n"
+			  << "  without options one frame is rendered to output.tga and depth.tga, several models are laid out like --instances\n"
+			  << "  --frames N       render a sequence of N frames to PREFIX_0000.tga, PREFIX_0001.tga, ...\n"
+			  << "  --orbit DEGREES  sequence camera circles the target by DEGREES over all frames (default 360)\n"
+			  << "  --path FILE      sequence camera follows the keyframes in FILE (\"ex ey ez tx ty tz\" per line)\n"
+			  << "  --out PREFIX     file name prefix of sequence frames (default frame)\n"
+			  << "  --stream FORMAT  send the frames as raw PPM or YUV4MPEG2 video to --out (a file or named pipe, default - for stdout) instead of TGA files\n"
+			  << "  --deferred       rasterize a visibility buffer first and shade every pixel once afterwards\n"
+			  << "  --msaa N         anti-alias with N (4 or 8) depth and color samples per pixel, shaded once per pixel\n"
+			  << "  --instances N    draw N copies of the models on a grid, each turned and tinted a little differently\n"
+			  << "  --spacing D      grid cells D apart in world units, the default fits the grid to the view\n"
+			  << "  --lod-error PX   draw the simplest level of detail whose error stays under PX pixels (default 1), 0 always draws full detail\n"
+			  << "  --depth FORMAT   depth buffer storage : float32 (default), unorm24 or unorm16\n"
+			  << "  --shadows        render a shadow map from a light above and to the left and darken what it doesn't reach\n"
+			  << "  --bench-shadow N time N shadow map passes with every raster kernel, depth only against the color kernels\n";
+}
+
+/*
+	Sequence mode : model, buffers and scratch memory are set up once and reused for every frame
+
+	--> two color buffers are used in turn, while the writer thread encodes and writes one of them the next
+		frame is drawn into the other one
+	--> the light follows the camera like in the single frame render
+*/
+int render_sequence(const std::vector<CameraKey> &path, const std::string &prefix, FrameStream *stream) {
+	TGAImage images[2] = {TGAImage(width, height, TGAImage::RGB), TGAImage(width, height, TGAImage::RGB)};
+	FrameScratch scratch;
+	FrameWriter writer(stream);
+
+	for (size_t f = 0; f < path.size(); f++) {
+		TGAImage &image = images[f % 2];
+		writer.wait(image);
+		image.clear();
+		zbuffer->clear();
+
+		const vec3f light_dir = (path[f].target - path[f].eye).normalize();
+		render_frame(path[f], light_dir, *zbuffer, image, *pool, scratch);
+
+		char name[32];
+		std::snprintf(name, sizeof(name), "_%04zu.tga", f);
+		writer.submit(image, prefix + name);
+	}
+	if (!writer.flush()) return 1;
+	std::cerr << path.size() << " frames written to " << (stream ? prefix : prefix + "_*.tga") << std::endl;
+	return 0;
 }
 
 int main(int argc, char** argv) {
 
-	if (argc == 2) {
-		model = new Model(argv[1]);
+	std::vector<const char*> model_files;
+	int frames = 0;
+	double orbit = 360;
+	const char *path_file = nullptr;
+	std::string prefix;
+	const char *stream_format = nullptr;
+	const char *depth_name = nullptr;
+	bool shadows = false;
+	int ninstances = 0;
+	double spacing = 0;
+	int bench_passes = 0;
+	for (int i = 1; i < argc; i++) {
+		const bool has_value = i + 1 < argc;
+		if (!std::strcmp(argv[i], "--frames") && has_value) frames = std::atoi(argv[++i]);
+		else if (!std::strcmp(argv[i], "--orbit") && has_value) orbit = std::atof(argv[++i]);
+		else if (!std::strcmp(argv[i], "--path") && has_value) path_file = argv[++i];
+		else if (!std::strcmp(argv[i], "--out") && has_value) prefix = argv[++i];
+		else if (!std::strcmp(argv[i], "--stream") && has_value) stream_format = argv[++i];
+		else if (!std::strcmp(argv[i], "--deferred")) deferred = true;
+		else if (!std::strcmp(argv[i], "--msaa") && has_value) msaa = std::atoi(argv[++i]);
+		else if (!std::strcmp(argv[i], "--instances") && has_value) ninstances = std::atoi(argv[++i]);
+		else if (!std::strcmp(argv[i], "--spacing") && has_value) spacing = std::atof(argv[++i]);
+		else if (!std::strcmp(argv[i], "--lod-error") && has_value) lod_error = std::atof(argv[++i]);
+		else if (!std::strcmp(argv[i], "--depth") && has_value) depth_name = argv[++i];
+		else if (!std::strcmp(argv[i], "--shadows")) shadows = true;
+		else if (!std::strcmp(argv[i], "--bench-shadow") && has_value) bench_passes = std::atoi(argv[++i]);
+		else if (argv[i][0] != '-') model_files.push_back(argv[i]);
+		else {
+			usage(argv[0]);
+			return 1;
+		}
 	}
-	else {
-		model = new Model("obj/african_head.obj",true,false,false);		
+
+	//samples only live per tile while it is drawn, the visibility buffer would need all of them at once
+	//the shadow map only covers the model where it stands alone
+	if (ninstances <= 0 && model_files.size() > 1) ninstances = static_cast<int>(model_files.size());
+	if ((msaa && msaa != 4 && msaa != 8) || (msaa && deferred) || (ninstances && shadows)) {
+		usage(argv[0]);
+		return 1;
+	}
+	if (depth_name && !parse_depth_format(depth_name, depth_format)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	//streams go to stdout unless --out names a file or pipe, a stream of its own is a one frame sequence
+	FrameStream::Format format = FrameStream::PPM;
+	if (stream_format && !parse_stream_format(stream_format, format)) {
+		usage(argv[0]);
+		return 1;
+	}
+	if (prefix.empty()) prefix = stream_format ? "-" : "frame";
+	if (stream_format && frames <= 0 && !path_file) frames = 1;
+
+	//camera path of a sequence, a keyframe file gives one frame per key unless --frames says otherwise
+	std::vector<CameraKey> path;
+	if (path_file) {
+		std::vector<CameraKey> keys;
+		if (!load_camera_path(path_file, keys)) return 1;
+		path = sample_path(keys, frames > 0 ? frames : static_cast<int>(keys.size()));
+	}
+	else if (frames > 0) {
+		path = orbit_path(CameraKey{cam, target}, frames, orbit);
+	}
+
+	if (model_files.empty()) {
+		models.push_back(new Model("obj/african_head.obj",true,false,false));
+	}
+	for (const char *file : model_files) {
+		models.push_back(new Model(file,true,false,false));
+	}
+	model = models[0];
+	//the single precision vertex stage reads positions from the SoA streams, levels of detail built after this get theirs too
+	if (vertex_single_precision()) {
+		for (Model *m : models) m->build_soa();
+	}
+	//levels of detail are built once at load, frames only pick one
+	if (lod_error > 0) {
+		for (Model *m : models) m->build_lods();
+	}
+
+	if (ninstances > 0) {
+		for (const Instance &inst : instance_grid(models, ninstances, spacing)) scene.add(inst);
+		scene.build();
 	}
 
 	//Initialize z-buffer
 	INIT_ZBUF();
 
-	TGAImage image(width, height, TGAImage::RGB);
+	pool = new ThreadPool();
+
+	if (bench_passes > 0) {
+		bench_shadow(bench_passes);
+		delete pool;
+		delete zbuffer;
+		for (Model *m : models) delete m;
+		return 0;
+	}
+
+	//the model and the light don't move, one shadow map serves every frame
+	if (shadows) {
+		shadow_map = new ShadowMap();
+		shadow_map->render(*model, sun_dir, *pool);
+	}
+
+	int status = 0;
+	if (!path.empty()) {
+		std::unique_ptr<FrameStream> stream;
+		if (stream_format) {
+			stream = std::make_unique<FrameStream>(prefix, format);
+			if (!stream->is_open()) return 1;
+		}
+		status = render_sequence(path, prefix, stream.get());
+	}
+	else {
+		TGAImage image(width, height, TGAImage::RGB);
+		FrameScratch scratch;
 
-	vec3f light_dir = (target-cam).normalize();
-	// vec3f light_dir = vec3f(1,-1,1).normalize();
+		vec3f light_dir = (target-cam).normalize();
+		// vec3f light_dir = vec3f(1,-1,1).normalize();
 
-	// untex_render(light_dir,zbuffer,model,image);
-	render(light_dir,zbuffer,model,image);
+		render_frame(CameraKey{cam, target},light_dir,*zbuffer,image,*pool,scratch);
+		write_depth(*zbuffer,*pool);
 
-	image.write_tga_file("output.tga");
-	delete model;
+		image.write_tga_file("output.tga", true, true, pool);
+	}
+	delete shadow_map;
+	delete pool;
+	delete zbuffer;
+	for (Model *m : models) delete m;
 
-	return 0;
+	return status;
 }
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+/*
+    Read only memory mapping of a whole file (POSIX mmap).
+
+    --> the pages are faulted in by the kernel on first touch, no copy into a user buffer
+    --> an empty file maps to {nullptr, 0}, that still counts as open
+*/
+class MappedFile
+{
+private:
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+    bool open_ = false;
+
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string &filename);
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    bool is_open() const { return open_; }
+    const char *data() const { return data_; }
+    size_t size() const { return size_; }
+};
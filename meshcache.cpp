@@ -0,0 +1,206 @@
+#include <bit>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "meshcache.h"
+
+namespace
+{
+
+const char magic[8] = {'T', 'R', 'M', 'E', 'S', 'H', 'C', '1'};
+const uint32_t version = 1;
+const size_t array_align = 64;
+const size_t narrays = 6;
+
+static_assert(std::is_trivially_copyable_v<vec3f> && std::is_trivially_copyable_v<vec2f>,
+              "mesh arrays are stored as raw bytes");
+
+// every field is 8 bytes wide so the struct has no padding and the same layout everywhere
+struct CacheHeader
+{
+    char magic[8];
+    uint64_t version;
+    uint64_t layout;  // sizeof(vec2f), sizeof(vec3f), sizeof(int) and the byte order packed together
+    uint64_t src_size;
+    int64_t src_mtime_ns;
+    uint64_t src_hash;
+    uint64_t count[narrays];   // elements : verts, uv, norms, facet_vrt, facet_tex, facet_nrm
+    uint64_t offset[narrays];  // byte offset of each array from the start of the file
+};
+
+uint64_t layout_tag()
+{
+    const uint64_t little = std::endian::native == std::endian::little;
+    return sizeof(vec2f) | sizeof(vec3f) << 16 | sizeof(int) << 32 | little << 48;
+}
+
+uint64_t fnv1a(const char *p, const size_t n)
+{
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < n; i++) h = (h ^ static_cast<unsigned char>(p[i])) * 0x100000001b3ull;
+    return h;
+}
+
+bool source_stat(const std::string &filename, uint64_t &size, int64_t &mtime_ns)
+{
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0) return false;
+    size = static_cast<uint64_t>(st.st_size);
+    mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    return true;
+}
+
+bool source_hash(const std::string &filename, uint64_t &hash)
+{
+    MappedFile src(filename);
+    if (!src.is_open()) return false;
+    hash = fnv1a(src.data(), src.size());
+    return true;
+}
+
+size_t align_up(const size_t x) { return (x + array_align - 1) / array_align * array_align; }
+
+// Writes the file through write(std::ofstream&) to a temporary and renames it over filename once everything is on
+// disk, so a crashed or concurrent writer never leaves a half written file and readers that mapped the old one
+// keep it. The temporary is unique per writer (mkstemp next to filename), two processes writing the same cache
+// each rename a whole file of their own and the last one wins
+template <typename F>
+bool replace_file(const std::string &filename, F &&write)
+{
+    std::string tmp = filename + ".XXXXXX";
+    const int fd = mkstemp(tmp.data());
+    if (fd < 0) return false;
+    // mkstemp makes it private to the user, the cache is an ordinary readable file
+    const bool made = fchmod(fd, 0644) == 0;
+    close(fd);
+
+    std::ofstream out;
+    if (made) out.open(tmp, std::ios::binary | std::ios::trunc);
+    if (out) {
+        write(out);
+        out.close();
+    }
+    if (!made || !out || std::rename(tmp.c_str(), filename.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+// true when every index is in [0, n)
+bool indices_below(std::span<const int> indices, const uint64_t n)
+{
+    bool ok = true;
+    for (const int i : indices) ok &= i >= 0 && static_cast<uint64_t>(i) < n;
+    return ok;
+}
+
+template <typename T>
+std::span<const T> array_at(const MappedFile &file, const CacheHeader &h, const size_t i)
+{
+    return std::span<const T>(reinterpret_cast<const T *>(file.data() + h.offset[i]), h.count[i]);
+}
+
+}  // namespace
+
+MeshView view_of(const ObjMesh &mesh)
+{
+    return MeshView{mesh.verts, mesh.uv, mesh.norms, mesh.facet_vrt, mesh.facet_tex, mesh.facet_nrm};
+}
+
+bool mesh_cache_enabled()
+{
+    const char *env = std::getenv("MESH_CACHE");
+    return !env || std::strcmp(env, "off") != 0;
+}
+
+std::string mesh_cache_path(const std::string &obj_filename) { return obj_filename + ".meshcache"; }
+
+bool write_mesh_cache(const std::string &cache_filename, const std::string &obj_filename, const ObjMesh &mesh)
+{
+    CacheHeader h{};
+    std::memcpy(h.magic, magic, sizeof(magic));
+    h.version = version;
+    h.layout = layout_tag();
+    if (!source_stat(obj_filename, h.src_size, h.src_mtime_ns)) return false;
+    if (!source_hash(obj_filename, h.src_hash)) return false;
+
+    const void *data[narrays] = {mesh.verts.data(),     mesh.uv.data(),        mesh.norms.data(),
+                                 mesh.facet_vrt.data(), mesh.facet_tex.data(), mesh.facet_nrm.data()};
+    const size_t bytes[narrays] = {mesh.verts.size() * sizeof(vec3f),    mesh.uv.size() * sizeof(vec2f),
+                                   mesh.norms.size() * sizeof(vec3f),    mesh.facet_vrt.size() * sizeof(int),
+                                   mesh.facet_tex.size() * sizeof(int), mesh.facet_nrm.size() * sizeof(int)};
+    const size_t elem[narrays] = {sizeof(vec3f), sizeof(vec2f), sizeof(vec3f), sizeof(int), sizeof(int), sizeof(int)};
+    size_t pos = align_up(sizeof(CacheHeader));
+    for (size_t i = 0; i < narrays; i++) {
+        h.count[i] = bytes[i] / elem[i];
+        h.offset[i] = pos;
+        pos = align_up(pos + bytes[i]);
+    }
+
+    return replace_file(cache_filename, [&](std::ofstream &out) {
+        static const char zeros[array_align] = {};
+        out.write(reinterpret_cast<const char *>(&h), sizeof(h));
+        size_t written = sizeof(h);
+        for (size_t i = 0; i < narrays; i++) {
+            out.write(zeros, h.offset[i] - written);
+            out.write(static_cast<const char *>(data[i]), bytes[i]);
+            written = h.offset[i] + bytes[i];
+        }
+    });
+}
+
+bool open_mesh_cache(const std::string &cache_filename, const std::string &obj_filename, MappedFile &file,
+                     MeshView &view)
+{
+    uint64_t src_size;
+    int64_t src_mtime_ns;
+    if (!source_stat(obj_filename, src_size, src_mtime_ns)) return false;
+
+    MappedFile cache(cache_filename);
+    if (!cache.is_open() || cache.size() < sizeof(CacheHeader)) return false;
+    CacheHeader h;
+    std::memcpy(&h, cache.data(), sizeof(h));
+    if (std::memcmp(h.magic, magic, sizeof(magic)) || h.version != version || h.layout != layout_tag()) return false;
+
+    if (h.src_size != src_size) return false;
+    const bool moved = h.src_mtime_ns != src_mtime_ns;
+    if (moved) {
+        uint64_t hash;
+        if (!source_hash(obj_filename, hash) || hash != h.src_hash) return false;
+    }
+
+    // --> every array has to be aligned for its type and lie inside the file
+    const size_t elem[narrays] = {sizeof(vec3f), sizeof(vec2f), sizeof(vec3f), sizeof(int), sizeof(int), sizeof(int)};
+    for (size_t i = 0; i < narrays; i++) {
+        if (h.offset[i] % array_align || h.offset[i] > cache.size()) return false;
+        if (h.count[i] > (cache.size() - h.offset[i]) / elem[i]) return false;
+    }
+    if (h.count[3] % 3 || h.count[4] != h.count[3] || h.count[5] != h.count[3]) return false;
+
+    // --> and every index has to point into its array, the header alone doesn't vouch for the payload
+    const MeshView v{array_at<vec3f>(cache, h, 0), array_at<vec2f>(cache, h, 1), array_at<vec3f>(cache, h, 2),
+                     array_at<int>(cache, h, 3),   array_at<int>(cache, h, 4),   array_at<int>(cache, h, 5)};
+    if (!indices_below(v.facet_vrt, h.count[0]) || !indices_below(v.facet_tex, h.count[1]) ||
+        !indices_below(v.facet_nrm, h.count[2]))
+        return false;
+
+    if (moved) {
+        // same content, store the new mtime so the next run doesn't have to hash again. The cache is rewritten
+        // whole like any other write, a failure only means hashing again next time
+        h.src_mtime_ns = src_mtime_ns;
+        replace_file(cache_filename, [&](std::ofstream &out) {
+            out.write(reinterpret_cast<const char *>(&h), sizeof(h));
+            out.write(cache.data() + sizeof(h), cache.size() - sizeof(h));
+        });
+    }
+
+    view = v;
+    file = std::move(cache);
+    return true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <span>
+#include <string>
+#include "geometry.h"
+#include "mappedfile.h"
+#include "objparser.h"
+
+// Read only views of a mesh's arrays, either into an ObjMesh or straight into a mapped cache file
+struct MeshView
+{
+    std::span<const vec3f> verts;
+    std::span<const vec2f> uv;
+    std::span<const vec3f> norms;
+    std::span<const int> facet_vrt, facet_tex, facet_nrm;
+};
+
+MeshView view_of(const ObjMesh &mesh);
+
+/*
+    Binary mesh cache, written next to the OBJ after a text load and memory mapped on later runs
+
+    --> the file is a fixed header followed by the six arrays, each 64 byte aligned and stored exactly as they sit
+        in memory (vec3f is 3 doubles, indices are int), so the mapped pages are used in place with no parse or copy
+    --> the header holds a magic, a format version, the sizes of vec2f/vec3f/int and the byte order, anything
+        that doesn't match this build is treated as a miss
+    --> it also records the source OBJ's size, mtime and 64 bit FNV-1a content hash. Same size and mtime is a hit
+        without reading the OBJ, if only the mtime moved the hash decides
+    --> writes go to a temporary file of their own (mkstemp next to the cache) renamed over the cache, so a
+        crashed or concurrent writer never leaves a half written cache behind, concurrent ones just replace each
+        other's whole file. That includes storing a new mtime after a hash hit
+    --> on open every array has to lie inside the file and every face index inside its array, checked once
+    --> a stale, foreign or damaged cache is simply a miss, the OBJ is parsed again and the cache rewritten
+*/
+bool mesh_cache_enabled();  // false when the MESH_CACHE environment variable is "off"
+std::string mesh_cache_path(const std::string &obj_filename);
+bool write_mesh_cache(const std::string &cache_filename, const std::string &obj_filename, const ObjMesh &mesh);
+bool open_mesh_cache(const std::string &cache_filename, const std::string &obj_filename, MappedFile &file,
+                     MeshView &view);
@@ -0,0 +1,101 @@
+#include "meshlet.h"
+#include <algorithm>
+#include <cmath>
+#include "model.h"
+
+static bool has_normal(const vec3f &n) { return std::isfinite(n.x) && std::isfinite(n.y) && std::isfinite(n.z); }
+
+std::vector<Meshlet> build_meshlets(std::span<const vec3f> positions, std::span<const int> facet_vrt,
+                                    const std::vector<vec3f> &face_normals, std::vector<std::uint32_t> &verts)
+{
+    std::vector<Meshlet> meshlets;
+    verts.clear();
+    const std::uint32_t nfaces = static_cast<std::uint32_t>(facet_vrt.size() / 3);
+    std::vector<std::uint32_t> last(positions.size(), UINT32_MAX);  // meshlet a vertex was last listed for
+
+    for (std::uint32_t begin = 0; begin < nfaces;) {
+        // the run grows while the average normal with the next face added keeps every normal within the cone
+        vec3f sum(0, 0, 0);
+        std::uint32_t end = begin;
+        for (; end < nfaces && end - begin < meshlet_max_faces; end++) {
+            const vec3f &n = face_normals[end];
+            if (!has_normal(n)) continue;
+            vec3f axis = sum + n;
+            if (end > begin && axis.norm() > 0) {
+                axis.normalize();
+                bool fits = true;
+                for (std::uint32_t f = begin; f <= end && fits; f++)
+                    if (has_normal(face_normals[f])) fits = dot(face_normals[f], axis) >= meshlet_max_cone;
+                if (!fits) break;
+            }
+            sum = sum + n;
+        }
+
+        Meshlet m{};
+        m.face_begin = begin;
+        m.face_end = end;
+        m.cone_axis = vec3f(0, 0, 1);
+        m.cone_cutoff = 2;
+        if (sum.norm() > 0) {
+            m.cone_axis = sum;
+            m.cone_axis.normalize();
+            double c = 1;
+            for (std::uint32_t f = begin; f < end; f++)
+                if (has_normal(face_normals[f])) c = std::min(c, dot(face_normals[f], m.cone_axis));
+            if (c > 0) m.cone_cutoff = std::sqrt(std::max(0.0, 1 - c * c));
+        }
+
+        m.vert_begin = static_cast<std::uint32_t>(verts.size());
+        vec3f lo = positions[facet_vrt[begin * 3]], hi = lo;
+        for (std::uint32_t i = begin * 3; i < end * 3; i++) {
+            const std::uint32_t v = facet_vrt[i];
+            if (last[v] == meshlets.size()) continue;
+            last[v] = static_cast<std::uint32_t>(meshlets.size());
+            verts.push_back(v);
+            const vec3f &p = positions[v];
+            lo = vec3f(std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z));
+            hi = vec3f(std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z));
+        }
+        m.vert_end = static_cast<std::uint32_t>(verts.size());
+        m.center = (lo + hi) * 0.5;
+        m.radius = 0;
+        for (std::uint32_t k = m.vert_begin; k < m.vert_end; k++)
+            m.radius = std::max(m.radius, (positions[verts[k]] - m.center).norm());
+
+        meshlets.push_back(m);
+        begin = end;
+    }
+    return meshlets;
+}
+
+void cull_meshlets(const Model &model, const vec3f &dir, const mat4 &mvp, const ClipParams &params, MeshletCull &out)
+{
+    out.meshlets.clear();
+    out.verts.clear();
+    out.faces = 0;
+    if (out.seen_.size() < model.nverts()) out.seen_.resize(model.nverts(), 0);
+    if (++out.stamp_ == 0) {
+        std::fill(out.seen_.begin(), out.seen_.end(), 0);
+        out.stamp_ = 1;
+    }
+
+    // every normal is within the cone's half angle a of the axis, so all of them face away from dir when the axis
+    // is more than 90 degrees + a from it : dot(axis, dir) < -sin(a) |dir|, with a little room for rounding
+    const double len = dir.norm();
+    const std::vector<Meshlet> &meshlets = model.meshlets();
+    const std::span<const std::uint32_t> verts = model.meshlet_verts();
+    for (std::uint32_t id = 0; id < meshlets.size(); id++) {
+        const Meshlet &m = meshlets[id];
+        if (dot(m.cone_axis, dir) < -(m.cone_cutoff + 1e-6) * len) continue;
+        if (sphere_outside(m.center, m.radius, mvp, params)) continue;
+
+        out.meshlets.push_back(id);
+        out.faces += m.face_end - m.face_begin;
+        for (std::uint32_t k = m.vert_begin; k < m.vert_end; k++) {
+            const std::uint32_t v = verts[k];
+            if (out.seen_[v] == out.stamp_) continue;
+            out.seen_[v] = out.stamp_;
+            out.verts.push_back(v);
+        }
+    }
+}
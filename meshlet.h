@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "clip.h"
+#include "geometry.h"
+
+class Model;
+
+// A run of consecutive faces of a model and what bounds them
+struct Meshlet
+{
+    std::uint32_t face_begin, face_end;  // faces [face_begin, face_end)
+    std::uint32_t vert_begin, vert_end;  // their vertices, once each, at [vert_begin, vert_end) of the model's list
+    vec3f center;                        // bounding sphere
+    double radius;
+    vec3f cone_axis;     // unit, every face normal lies within the cone around it
+    double cone_cutoff;  // sine of the cone's half angle, > 1 when it is 90 degrees or wider
+};
+
+/*
+	Meshlets : faces grouped in clusters of up to max_faces, built once at load
+
+	--> a meshlet is a run of consecutive faces, so drawing the visible ones in order keeps the model's submission
+		order. A face joins the run while every normal of it stays within max_cone of their average direction,
+		OBJ exporters write faces in strips and patches so runs follow the surface well enough
+	--> the normal cone is exact for the faces it holds (the largest angle to the axis), the sphere is centered on
+		the vertices' bbox
+	--> faces without a normal (zero area) never pass the shaders' light test, they don't widen the cone
+*/
+const std::uint32_t meshlet_max_faces = 64;
+const double meshlet_max_cone = 0.7;  // cosine of the widest angle a normal may make with the axis
+
+// meshlets of the faces (3 vertex indices each), verts gets the vertex list they point into
+std::vector<Meshlet> build_meshlets(std::span<const vec3f> positions, std::span<const int> facet_vrt,
+                                    const std::vector<vec3f> &face_normals, std::vector<std::uint32_t> &verts);
+
+/*
+	Per frame meshlet culling, before the vertex stage
+
+	--> a meshlet whose cone lies entirely on the far side of dir is dropped : every face normal n in it has
+		dot(n, dir) < 0, which is what the shaders' per face test (face_lambert() > 0, the light in the model's
+		space) would have thrown its faces away for. It is the same test on the whole cone, so no face that test
+		keeps is lost
+	--> a meshlet whose sphere lies outside one frustum plane is dropped too
+	--> what is left gives the faces to set up, in order, and the vertices to transform, each once
+*/
+class MeshletCull;
+
+// dir is the model space direction the shader culls faces against, mvp goes to clip space
+void cull_meshlets(const Model &model, const vec3f &dir, const mat4 &mvp, const ClipParams &params, MeshletCull &out);
+
+class MeshletCull
+{
+private:
+    std::vector<std::uint32_t> seen_;  // stamp_ when a vertex is already in verts
+    std::uint32_t stamp_ = 0;
+
+    friend void cull_meshlets(const Model &, const vec3f &, const mat4 &, const ClipParams &, MeshletCull &);
+
+public:
+    std::vector<std::uint32_t> meshlets;  // ids of the visible meshlets, ascending
+    std::vector<std::uint32_t> verts;     // vertices of those, each once
+    size_t faces = 0;                     // faces of those
+};
@@ -1,52 +1,26 @@
+#include <algorithm>
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include "model.h"
+#include "meshcache.h"
+#include "simplify.h"
 
 Model::Model(const std::string filename, bool diffuse_texture, bool normal_map,
              bool specular_texture)
+    : diffusemap_(std::make_shared<Texture>()), normalmap_(diffusemap_), specularmap_(diffusemap_)
 {
-    std::ifstream in;
-    in.open(filename, std::ifstream::in);
-    if (in.fail()) return;
-    std::string line;
-    while (!in.eof()) {
-        std::getline(in, line);
-        std::istringstream iss(line.c_str());
-        char trash;
-        if (!line.compare(0, 2, "v ")) {
-            iss >> trash;
-            vec3f v;
-            for (size_t i = 0; i < 3; i++) iss >> v[i];
-            verts_.push_back(v);
-        } else if (!line.compare(0, 3, "vn ")) {
-            iss >> trash >> trash;
-            vec3f n;
-            for (size_t i = 0; i < 3; i++) iss >> n[i];
-            norms_.push_back(n.normalize());
-        } else if (!line.compare(0, 3, "vt ")) {
-            iss >> trash >> trash;
-            vec2f uv;
-            for (size_t i = 0; i < 2; i++) iss >> uv[i];
-            uv_.push_back(uv);
-        } else if (!line.compare(0, 2, "f ")) {
-            int f, t, n;
-            iss >> trash;
-            int cnt = 0;
-            while (iss >> f >> trash >> t >> trash >> n) {
-                facet_vrt_.push_back(--f);
-                facet_tex_.push_back(--t);
-                facet_nrm_.push_back(--n);
-                cnt++;
-            }
-            if (3 != cnt) {
-                std::cerr << "Error: the obj file is supposed to be triangulated" << std::endl;
-                in.close();
-                return;
-            }
-        }
+    const bool use_cache = mesh_cache_enabled();
+    const std::string cache_file = mesh_cache_path(filename);
+    MeshView view;
+    if (use_cache && open_mesh_cache(cache_file, filename, cache_, view)) {
+        std::cerr << "mesh cache " << cache_file << " loaded" << std::endl;
+        set_views(view);
+    } else {
+        const bool ok = parse_obj(filename, mesh_);
+        set_views(view_of(mesh_));
+        if (!ok) return;
+        if (use_cache && !write_mesh_cache(cache_file, filename, mesh_))
+            std::cerr << "mesh cache " << cache_file << " could not be written" << std::endl;
     }
-    in.close();
     std::cerr << "# v# " << nverts() << " f# " << nfaces() << " vt# " << uv_.size() << " vn# "
               << norms_.size() << std::endl;
     if (diffuse_texture) load_texture(filename, "_diffuse.tga", diffusemap_);
@@ -54,6 +28,46 @@ Model::Model(const std::string filename, bool diffuse_texture, bool normal_map,
     if (specular_texture) load_texture(filename, "_spec.tga", specularmap_);
 }
 
+Model::Model(ObjMesh mesh, const Model &full, const double error)
+    : mesh_(std::move(mesh)), diffusemap_(full.diffusemap_), normalmap_(full.normalmap_),
+      specularmap_(full.specularmap_), lod_error_(error)
+{
+    set_views(view_of(mesh_));
+    if (full.has_soa()) build_soa();
+}
+
+void Model::build_lods(const int levels, const double ratio)
+{
+    lods_.clear();
+    const MeshView view{verts_, uv_, norms_, facet_vrt_, facet_tex_, facet_nrm_};
+    for (MeshLod &lod : build_lod_chain(view, levels, ratio))
+        lods_.push_back(std::unique_ptr<Model>(new Model(std::move(lod.mesh), *this, lod.error)));
+}
+
+void Model::set_views(const MeshView &view)
+{
+    verts_ = view.verts;
+    uv_ = view.uv;
+    norms_ = view.norms;
+    facet_vrt_ = view.facet_vrt;
+    facet_tex_ = view.facet_tex;
+    facet_nrm_ = view.facet_nrm;
+
+    bbox_min_ = bbox_max_ = verts_.empty() ? vec3f(0, 0, 0) : verts_[0];
+    for (const vec3f &v : verts_) {
+        bbox_min_ = vec3f(std::min(bbox_min_.x, v.x), std::min(bbox_min_.y, v.y), std::min(bbox_min_.z, v.z));
+        bbox_max_ = vec3f(std::max(bbox_max_.x, v.x), std::max(bbox_max_.y, v.y), std::max(bbox_max_.z, v.z));
+    }
+
+    // every frame (and every instance) lights faces with these, so they're only worked out once
+    face_normals_.resize(nfaces());
+    for (size_t i = 0; i < nfaces(); i++) {
+        const vec3f p0 = vert(i, 0), p1 = vert(i, 1), p2 = vert(i, 2);
+        face_normals_[i] = cross(p2 - p0, p1 - p0).normalize();
+    }
+    meshlets_ = build_meshlets(verts_, facet_vrt_, face_normals_, meshlet_verts_);
+}
+
 size_t Model::nverts() const { return verts_.size(); }
 
 size_t Model::nfaces() const { return facet_vrt_.size() / 3; }
@@ -65,39 +79,51 @@ vec3f Model::vert(const size_t iface, const size_t nthvert) const
     return verts_[facet_vrt_[iface * 3 + nthvert]];
 }
 
-std::vector<int> Model::face(int idx) const {
-    std::vector<int> idx_face;
-    int j = 3*(idx-1);
-    if(idx == 0){
-        j = 0;
-    }
-    idx_face.push_back(facet_vrt_[j]);
-    idx_face.push_back(facet_vrt_[j+1]);
-    idx_face.push_back(facet_vrt_[j+2]);
+size_t Model::vert_index(const size_t iface, const size_t nthvert) const
+{
+    return facet_vrt_[iface * 3 + nthvert];
+}
 
-    return idx_face;
+std::span<const int> Model::face(const size_t idx) const
+{
+    return facet_vrt_.subspan(idx * 3, 3);
 }
 
-void Model::load_texture(std::string filename, const std::string suffix, TGAImage &img)
+void Model::build_soa()
+{
+    soa_ = MeshSoA();
+    soa_.x.reserve(verts_.size());
+    soa_.y.reserve(verts_.size());
+    soa_.z.reserve(verts_.size());
+    for (const vec3f &v : verts_) {
+        soa_.x.push_back(static_cast<float>(v.x));
+        soa_.y.push_back(static_cast<float>(v.y));
+        soa_.z.push_back(static_cast<float>(v.z));
+    }
+}
+
+bool Model::has_soa() const { return !soa_.x.empty(); }
+
+void Model::load_texture(std::string filename, const std::string suffix, std::shared_ptr<const Texture> &tex)
 {
     size_t dot = filename.find_last_of(".");
     if (dot == std::string::npos) return;
     std::string texfile = filename.substr(0, dot) + suffix;
+    TGAImage img;
     std::cerr << "texture file " << texfile << " loading "
               << (img.read_tga_file(texfile.c_str()) ? "ok" : "failed") << std::endl;
     img.flip_vertically();
+    tex = std::make_shared<Texture>(img);  // tiles it and builds the mip chain
 }
 
 TGAColor Model::diffuse(const vec2f &uvf) const
 {
-    return diffusemap_.get(static_cast<size_t>(uvf[0] * diffusemap_.get_width()),
-                           static_cast<size_t>(uvf[1] * diffusemap_.get_height()));
+    return diffusemap_->sample(uvf[0], uvf[1]);
 }
 
 vec3f Model::normal(const vec2f &uvf) const
 {
-    TGAColor c = normalmap_.get(static_cast<size_t>(uvf[0] * normalmap_.get_width()),
-                                static_cast<size_t>(uvf[1] * normalmap_.get_height()));
+    TGAColor c = normalmap_->sample(uvf[0], uvf[1]);
     vec3f res;
     for (size_t i = 0; i < 3; i++) res[2 - i] = c[i] / 255. * 2 - 1;
     return res;
@@ -105,8 +131,7 @@ vec3f Model::normal(const vec2f &uvf) const
 
 double Model::specular(const vec2f &uvf) const
 {
-    return specularmap_.get(static_cast<size_t>(uvf[0] * specularmap_.get_width()),
-                            static_cast<size_t>(uvf[1] * specularmap_.get_height()))[0];
+    return specularmap_->sample(uvf[0], uvf[1])[0];
 }
 
 vec2f Model::uv(const size_t iface, const size_t nthvert) const
@@ -1,24 +1,50 @@
 #pragma once
+#include <memory>
 #include <vector>
+#include <span>
 #include <string>
 #include "geometry.h"
 #include "tgaimage.h"
+#include "texture.h"
+#include "meshcache.h"
+#include "meshlet.h"
+
+/*
+    Structure of arrays copy of the vertex positions, one contiguous stream per component for the single precision
+    vertex transform (a 256 bit register holds 8 of them)
+*/
+struct MeshSoA
+{
+    std::vector<float> x, y, z;  // vertex positions
+};
 
 class Model
 {
 private:
-    std::vector<vec3f> verts_;  // array of vertices
-    std::vector<vec2f> uv_;     // array of tex coords
-    std::vector<vec3f> norms_;  // array of normal vectors
-    std::vector<int> facet_vrt_;
-    std::vector<int> facet_tex_;  // indices in the above arrays per triangle
-    std::vector<int> facet_nrm_;
-    TGAImage diffusemap_;   // diffuse color texture
-    TGAImage normalmap_;    // normal map texture
-    TGAImage specularmap_;  // specular map texture
-    void load_texture(const std::string filename, const std::string suffix, TGAImage &img);
+    ObjMesh mesh_;       // arrays parsed from the OBJ text
+    MappedFile cache_;   // or the mapped binary cache, the views below point into one of the two
+    std::span<const vec3f> verts_;  // array of vertices
+    std::span<const vec2f> uv_;     // array of tex coords
+    std::span<const vec3f> norms_;  // array of normal vectors
+    std::span<const int> facet_vrt_;
+    std::span<const int> facet_tex_;  // indices in the above arrays per triangle
+    std::span<const int> facet_nrm_;
+    std::shared_ptr<const Texture> diffusemap_;   // diffuse color texture
+    std::shared_ptr<const Texture> normalmap_;    // normal map texture
+    std::shared_ptr<const Texture> specularmap_;  // specular map texture, all three tiled and mipmapped (see texture.h)
+    MeshSoA soa_;           // optional SoA layout, empty until build_soa()
+    vec3f bbox_min_, bbox_max_;  // bounding box of the vertices
+    std::vector<vec3f> face_normals_;  // unit normal of every face, computed once at load
+    std::vector<Meshlet> meshlets_;    // the faces in clusters (see meshlet.h), also built at load
+    std::vector<std::uint32_t> meshlet_verts_;
+    std::vector<std::unique_ptr<Model>> lods_;  // simplified copies sharing the textures, lods_[i] is level i + 1
+    double lod_error_ = 0;  // how far this mesh may stray from the full detail one, in model units
+    void load_texture(const std::string filename, const std::string suffix, std::shared_ptr<const Texture> &tex);
+    void set_views(const MeshView &view);
+    Model(ObjMesh mesh, const Model &full, const double error);  // a level of full
 
 public:
+    // Loads the OBJ, or its binary cache (see meshcache.h) when that is still valid, a text load writes the cache
     Model(const std::string filename, bool diffuse_texture = false, bool normal_map = false,
           bool specular_texture = false);
     size_t nverts() const;
@@ -28,8 +54,29 @@ public:
     vec3f normal(const vec2f &uv) const;  // fetch the normal vector from the normal map texture
     vec3f vert(const size_t i) const;
     vec3f vert(const size_t iface, const size_t nthvert) const;
-    std::vector<int> face(int idx) const;
+    size_t vert_index(const size_t iface, const size_t nthvert) const;  // index into the vertex array
+    const vec3f &face_normal(const size_t iface) const { return face_normals_[iface]; }  // flat, from the corners' winding
+    const std::vector<Meshlet> &meshlets() const { return meshlets_; }
+    std::span<const std::uint32_t> meshlet_verts() const { return meshlet_verts_; }  // what Meshlet::vert_begin indexes
+    std::span<const int> face(const size_t idx) const;  // vertex indices of a face
+    const vec3f &bbox_min() const { return bbox_min_; }
+    const vec3f &bbox_max() const { return bbox_max_; }
     vec2f uv(const size_t iface, const size_t nthvert) const;
     TGAColor diffuse(const vec2f &uv) const;
+    const Texture &diffuse_map() const { return *diffusemap_; }  // for the rasterizers' inline fetch
     double specular(const vec2f &uv) const;
+
+    // Levels of detail, simplified by quadric edge collapse (see simplify.h) and sharing this model's textures.
+    // Level 0 is the model itself, each level has about ratio times the faces of the one before
+    void build_lods(const int levels = 8, const double ratio = 0.5);
+    size_t nlods() const { return lods_.size() + 1; }
+    const Model &lod(const size_t level) const { return level ? *lods_[level - 1] : *this; }
+    double lod_error() const { return lod_error_; }
+
+    // SoA positions, build_soa() fills them from verts_, the spans are empty before that
+    void build_soa();
+    bool has_soa() const;
+    std::span<const float> pos_x() const { return soa_.x; }
+    std::span<const float> pos_y() const { return soa_.y; }
+    std::span<const float> pos_z() const { return soa_.z; }
 };
\ No newline at end of file
@@ -0,0 +1,198 @@
+#include "msaa.h"
+#include <limits>
+
+#if RASTER_SIMD
+#include <immintrin.h>
+#endif
+
+// standard D3D sample positions, in 1/16 of a pixel from the pixel's position
+static const int pattern4[4][2] = {{-2, -6}, {6, -2}, {-6, 2}, {2, 6}};
+static const int pattern8[8][2] = {{1, -3}, {-1, 3}, {5, 1}, {-3, -5}, {-5, 5}, {-7, -1}, {3, 7}, {7, -7}};
+
+SampleTile::SampleTile(const int samples, const int size)
+    : samples_(samples == 8 ? 8 : 4), size_(size),
+      depth_(static_cast<size_t>(size) * size * samples_), color_(depth_.size())
+{
+    for (int s = 0; s < samples_; s++) {
+        const int *p = samples_ == 8 ? pattern8[s] : pattern4[s];
+        dx[s] = p[0] / 16.;
+        dy[s] = p[1] / 16.;
+    }
+}
+
+void SampleTile::begin(const Tile &tile)
+{
+    tile_ = tile;
+    const size_t n = static_cast<size_t>(tile.y1 - tile.y0 + 1) * size_ * samples_;
+    std::fill(depth_.begin(), depth_.begin() + n, -std::numeric_limits<float>::max());
+    std::fill(color_.begin(), color_.begin() + n, 0u);
+}
+
+/*
+	Color resolve, one row of a tile at a time : the samples of n pixels to n pixels of BPP bytes at out
+
+	--> each channel is the rounded average of the samples' channels. The SIMD versions widen the samples to 16
+		bits and add them up in halves until one 64 bit lane holds the four channel sums of a pixel, which gives
+		exactly the scalar result
+*/
+template <int N, int BPP>
+static void resolve_row_scalar(const std::uint32_t *samples, std::uint8_t *out, const int n)
+{
+    for (int i = 0; i < n; i++, samples += N) {
+        std::uint32_t c = 0;
+        for (int shift = 0; shift < 32; shift += 8) {
+            std::uint32_t sum = N / 2;
+            for (int s = 0; s < N; s++) sum += samples[s] >> shift & 0xff;
+            c |= sum / N << shift;
+        }
+        memcpy(out + i * BPP, &c, BPP);
+    }
+}
+
+#if RASTER_SIMD
+
+template <int N, int BPP>
+__attribute__((target("sse4.1"))) static void resolve_row_sse41(const std::uint32_t *samples, std::uint8_t *out,
+                                                                const int n)
+{
+    const __m128i zero = _mm_setzero_si128(), round = _mm_set1_epi16(N / 2);
+    for (int i = 0; i < n; i++, samples += N) {
+        // 4 samples per load, 2 of them per 16 bit half
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(samples));
+        __m128i sum = _mm_add_epi16(_mm_cvtepu8_epi16(v), _mm_unpackhi_epi8(v, zero));
+        if constexpr (N == 8) {
+            v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(samples + 4));
+            sum = _mm_add_epi16(sum, _mm_add_epi16(_mm_cvtepu8_epi16(v), _mm_unpackhi_epi8(v, zero)));
+        }
+        sum = _mm_add_epi16(sum, _mm_shuffle_epi32(sum, 0x4e));
+        sum = _mm_srli_epi16(_mm_add_epi16(sum, round), N == 8 ? 3 : 2);
+        const std::uint32_t c = _mm_cvtsi128_si32(_mm_packus_epi16(sum, sum));
+        memcpy(out + i * BPP, &c, BPP);
+    }
+}
+
+// two pixels per step at 4x (one per 128 bit lane), one at 8x
+template <int N, int BPP>
+__attribute__((target("avx2"))) static void resolve_row_avx2(const std::uint32_t *samples, std::uint8_t *out,
+                                                             const int n)
+{
+    const __m256i zero = _mm256_setzero_si256(), round = _mm256_set1_epi16(N / 2);
+    constexpr int step = N == 8 ? 1 : 2;
+    int i = 0;
+    for (; i + step <= n; i += step, samples += 8) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(samples));
+        __m256i sum = _mm256_add_epi16(_mm256_unpacklo_epi8(v, zero), _mm256_unpackhi_epi8(v, zero));
+        sum = _mm256_add_epi16(sum, _mm256_shuffle_epi32(sum, 0x4e));
+        if constexpr (N == 8) sum = _mm256_add_epi16(sum, _mm256_permute2x128_si256(sum, sum, 0x01));
+        sum = _mm256_srli_epi16(_mm256_add_epi16(sum, round), N == 8 ? 3 : 2);
+        const __m256i c = _mm256_packus_epi16(sum, sum);
+        const std::uint32_t c0 = _mm256_cvtsi256_si32(c);
+        memcpy(out + i * BPP, &c0, BPP);
+        if constexpr (N == 4) {
+            const std::uint32_t c1 = _mm_cvtsi128_si32(_mm256_extracti128_si256(c, 1));
+            memcpy(out + (i + 1) * BPP, &c1, BPP);
+        }
+    }
+    if (i < n) resolve_row_sse41<N, BPP>(samples, out + i * BPP, n - i);
+}
+
+#endif
+
+template <int N, int BPP>
+static void resolve_color(const std::uint32_t *samples, const int stride, TGAImage &image, const Tile &r)
+{
+    const int width = image.get_width();
+    auto row = resolve_row_scalar<N, BPP>;
+#if RASTER_SIMD
+    if (raster_kernel() == RasterKernel::AVX2) row = resolve_row_avx2<N, BPP>;
+    else if (raster_kernel() == RasterKernel::SSE41) row = resolve_row_sse41<N, BPP>;
+#endif
+    for (int y = r.y0; y <= r.y1; y++, samples += stride) {
+        row(samples, image.buffer() + (r.x0 + static_cast<size_t>(y) * width) * BPP, r.x1 - r.x0 + 1);
+    }
+}
+
+template <int N>
+static void resolve_color(const std::uint32_t *samples, const int stride, TGAImage &image, const Tile &r)
+{
+    if (image.get_bytespp() == TGAImage::RGBA) resolve_color<N, 4>(samples, stride, image, r);
+    else resolve_color<N, 3>(samples, stride, image, r);
+}
+
+/*
+	Depth resolve, closest sample of each pixel, encoded for the depth buffer
+*/
+template <DepthBuffer::Format F>
+static inline void store_depth(typename DepthStorage<F>::type *zp, const float z, const DepthBuffer &zb)
+{
+    if constexpr (F == DepthBuffer::FLOAT32) *zp = z;
+    else *zp = static_cast<typename DepthStorage<F>::type>(zb.encode(z));
+}
+
+template <DepthBuffer::Format F, int N>
+static void resolve_depth_row_scalar(const float *samples, typename DepthStorage<F>::type *out, const int n,
+                                     const DepthBuffer &zb)
+{
+    for (int i = 0; i < n; i++, samples += N) {
+        float closest = samples[0];
+        for (int s = 1; s < N; s++) closest = std::max(closest, samples[s]);
+        store_depth<F>(out + i, closest, zb);
+    }
+}
+
+#if RASTER_SIMD
+template <DepthBuffer::Format F, int N>
+__attribute__((target("sse4.1"))) static void resolve_depth_row_sse41(const float *samples,
+                                                                      typename DepthStorage<F>::type *out,
+                                                                      const int n, const DepthBuffer &zb)
+{
+    for (int i = 0; i < n; i++, samples += N) {
+        __m128 m = _mm_loadu_ps(samples);
+        if constexpr (N == 8) m = _mm_max_ps(m, _mm_loadu_ps(samples + 4));
+        m = _mm_max_ps(m, _mm_shuffle_ps(m, m, 0x4e));
+        m = _mm_max_ps(m, _mm_shuffle_ps(m, m, 0xb1));
+        store_depth<F>(out + i, _mm_cvtss_f32(m), zb);
+    }
+}
+#endif
+
+template <DepthBuffer::Format F, int N>
+static void resolve_depth(const float *samples, const int stride, DepthBuffer &zb, const Tile &r)
+{
+    using T = typename DepthStorage<F>::type;
+    auto row = resolve_depth_row_scalar<F, N>;
+#if RASTER_SIMD
+    if (raster_kernel() != RasterKernel::Scalar) row = resolve_depth_row_sse41<F, N>;
+#endif
+    for (int y = r.y0; y <= r.y1; y++, samples += stride) {
+        row(samples, zb.data<T>() + r.x0 + static_cast<size_t>(y) * zb.width(), r.x1 - r.x0 + 1, zb);
+    }
+}
+
+template <int N>
+static void resolve_depth(const float *samples, const int stride, DepthBuffer &zb, const Tile &r)
+{
+    switch (zb.format()) {
+        case DepthBuffer::FLOAT32: resolve_depth<DepthBuffer::FLOAT32, N>(samples, stride, zb, r); break;
+        case DepthBuffer::UNORM24: resolve_depth<DepthBuffer::UNORM24, N>(samples, stride, zb, r); break;
+        default: resolve_depth<DepthBuffer::UNORM16, N>(samples, stride, zb, r); break;
+    }
+}
+
+void SampleTile::resolve(TGAImage &image, DepthBuffer &zb) const
+{
+    const Tile r = {tile_.x0, tile_.y0, std::min<int>(tile_.x1, image.get_width() - 1),
+                    std::min<int>(tile_.y1, image.get_height() - 1)};
+    if (r.x0 > r.x1 || r.y0 > r.y1) return;
+    const int stride = size_ * samples_;
+
+    if (samples_ == 8) resolve_color<8>(color_.data(), stride, image, r);
+    else resolve_color<4>(color_.data(), stride, image, r);
+
+    if (samples_ == 8) resolve_depth<8>(depth_.data(), stride, zb, r);
+    else resolve_depth<4>(depth_.data(), stride, zb, r);
+    // the depths were written behind the coarse level's back, it recomputes them when they're next tested
+    const int bs = HiZBuffer::block;
+    for (int by = r.y0 / bs; by <= r.y1 / bs; by++)
+        for (int bx = r.x0 / bs; bx <= r.x1 / bs; bx++) zb.hiz().mark_dirty(bx, by);
+}
@@ -0,0 +1,170 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "depthbuffer.h"
+#include "raster_simd.h"
+#include "shader.h"
+#include "tgaimage.h"
+#include "tiles.h"
+#include "trianglesetup.h"
+
+/*
+	Multisample anti-aliasing
+
+	--> every pixel has N (4 or 8) samples at the standard D3D positions around the pixel's own position, coverage
+		and the depth test run per sample. The fragment stage runs once per pixel, at the pixel's position like in
+		the single sample pass, and its color goes to every sample that passed
+	--> samples only exist for one tile at a time : a tile draws all its triangles into a SampleTile and resolves
+		it into the image and the depth buffer before it's done, so a pass needs a tile of samples per thread
+		(256KB at 8x) rather than N full screen color and depth buffers
+	--> the samples of a pixel sit next to each other, the SIMD kernels test them as one vector and the resolve
+		averages them with a few integer adds per pixel
+	--> sample depths are truncated like the single sample kernels' and kept as floats, comparisons are on those
+		(encode() of the depth buffer is monotonic, so the order is the same). The resolve keeps the closest
+		sample of each pixel in the depth buffer
+*/
+class SampleTile
+{
+private:
+    int samples_, size_;
+    Tile tile_{};
+    std::vector<float> depth_;          // samples of pixel (x, y) start at ((x - x0) + (y - y0) * size) * samples
+    std::vector<std::uint32_t> color_;  // bgra, same layout
+
+    size_t index(const int x, const int y) const
+    {
+        return static_cast<size_t>((x - tile_.x0) + (y - tile_.y0) * size_) * samples_;
+    }
+
+public:
+    static constexpr int max_samples = 8;
+    // sample s of pixel (x, y) lies at (x + dx[s], y + dy[s])
+    double dx[max_samples] = {}, dy[max_samples] = {};
+
+    // samples is 4 or 8, size the largest tile drawn into it
+    SampleTile(const int samples, const int size = 64);
+
+    int samples() const { return samples_; }
+    const Tile &tile() const { return tile_; }
+
+    // starts drawing tile with every sample cleared to nothing drawn, black and the farthest depth
+    void begin(const Tile &tile);
+
+    float *depth(const int x, const int y) { return depth_.data() + index(x, y); }
+    std::uint32_t *color(const int x, const int y) { return color_.data() + index(x, y); }
+
+    // average of every pixel's samples into image, its closest sample into zb
+    void resolve(TGAImage &image, DepthBuffer &zb) const;
+};
+
+// Per sample offsets of one triangle's planes from their value at the pixel's position
+struct SampleOffsets
+{
+    alignas(32) double w[3][SampleTile::max_samples];
+    alignas(32) double z[SampleTile::max_samples];
+    double reach[3];  // largest offset of w[k], no sample of a pixel is inside edge k unless w[k] + reach[k] >= 0
+
+    SampleOffsets(const TriangleSetup &t, const SampleTile &tile)
+    {
+        for (int k = 0; k < 3; k++) reach[k] = -1e30;
+        for (int s = 0; s < SampleTile::max_samples; s++) {
+            for (int k = 0; k < 3; k++) {
+                w[k][s] = t.w[k].a * tile.dx[s] + t.w[k].b * tile.dy[s];
+                if (s < tile.samples()) reach[k] = std::max(reach[k], w[k][s]);
+            }
+            z[s] = t.z.a * tile.dx[s] + t.z.b * tile.dy[s];
+        }
+    }
+};
+
+/*
+	Reference kernel, one pixel and one sample at a time, the SIMD kernels must match what it draws
+
+	--> the w planes are stepped from pixel to pixel like in raster_scalar() and each sample adds its offset, so a
+		sample is inside exactly when the kernels below say it is
+	--> the reach test is a plain edge test with the edges pushed out, so the pixels where it passes are still
+		contiguous along a row and the row ends at the first pixel after them
+*/
+template <Shader S>
+inline void raster_msaa_scalar(const S &shader, const typename S::Face &face, const TriangleSetup &t,
+                               SampleTile &st, const Tile &clip)
+{
+    const int xmin = std::max(clip.x0, t.xmin), xmax = std::min(clip.x1, t.xmax);
+    const int ymin = std::max(clip.y0, t.ymin), ymax = std::min(clip.y1, t.ymax);
+    if (xmin > xmax || ymin > ymax) return;
+    const int n = st.samples();
+    const typename S::Bound bound = shader.bind(t, face);
+    const SampleOffsets off(t, st);
+
+    double w0_row = t.w[0].at(xmin, ymin), w1_row = t.w[1].at(xmin, ymin), w2_row = t.w[2].at(xmin, ymin);
+    double z_row = t.z.at(xmin, ymin), u_row = 0, v_row = 0;
+    if constexpr (S::uses_uv) {
+        u_row = t.u.at(xmin, ymin);
+        v_row = t.v.at(xmin, ymin);
+    }
+
+    for (int y = ymin; y <= ymax; y++) {
+        double w0 = w0_row, w1 = w1_row, w2 = w2_row;
+        double z = z_row, u = u_row, v = v_row;
+        bool entered = false;
+
+        for (int x = xmin; x <= xmax; x++) {
+            if (w0 + off.reach[0] >= 0 && w1 + off.reach[1] >= 0 && w2 + off.reach[2] >= 0) {
+                entered = true;
+                float *zp = st.depth(x, y);
+                float pz[SampleTile::max_samples];
+                int pass = 0;
+                for (int s = 0; s < n; s++) {
+                    if (!(w0 + off.w[0][s] >= 0 && w1 + off.w[1][s] >= 0 && w2 + off.w[2][s] >= 0)) continue;
+                    pz[s] = static_cast<float>(std::trunc(z + off.z[s]));
+                    if (zp[s] < pz[s]) pass |= 1 << s;
+                }
+                if (pass) {
+                    const std::uint32_t c = shader.fragment(bound, x, y, u, v);
+                    std::uint32_t *cp = st.color(x, y);
+                    for (int s = 0; s < n; s++) {
+                        if (!(pass >> s & 1)) continue;
+                        zp[s] = pz[s];
+                        cp[s] = c;
+                    }
+                }
+            } else if (entered) {
+                break;
+            }
+
+            w0 += t.w[0].a;
+            w1 += t.w[1].a;
+            w2 += t.w[2].a;
+            z += t.z.a;
+            if constexpr (S::uses_uv) {
+                u += t.u.a;
+                v += t.v.a;
+            }
+        }
+
+        w0_row += t.w[0].b;
+        w1_row += t.w[1].b;
+        w2_row += t.w[2].b;
+        z_row += t.z.b;
+        if constexpr (S::uses_uv) {
+            u_row += t.u.b;
+            v_row += t.v.b;
+        }
+    }
+}
+
+// Draws a triangle with shader S into the samples of the tile st is drawing, with the widest kernel the cpu supports
+template <Shader S>
+inline void draw_triangle_msaa(const S &shader, const typename S::Face &face, const TriangleSetup &t, SampleTile &st)
+{
+    switch (raster_kernel()) {
+#if RASTER_SIMD
+        case RasterKernel::AVX2: raster_msaa_avx2(shader, face, t, st, st.tile()); return;
+        case RasterKernel::SSE41: raster_msaa_sse41(shader, face, t, st, st.tile()); return;
+#endif
+        default: raster_msaa_scalar(shader, face, t, st, st.tile()); return;
+    }
+}
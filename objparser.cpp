@@ -0,0 +1,266 @@
+#include <algorithm>
+#include <charconv>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include "objparser.h"
+#include "mappedfile.h"
+#include "threadpool.h"
+
+namespace
+{
+
+const size_t min_chunk_bytes = 1 << 20;  // below this splitting the file costs more than it saves
+
+const double exact_pow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                              1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+struct ObjChunk
+{
+    ObjMesh mesh;
+    bool error = false;
+};
+
+inline bool is_space(const char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f'; }
+inline bool is_digit(const char c) { return c >= '0' && c <= '9'; }
+
+inline const char *skip_space(const char *p, const char *end)
+{
+    while (p < end && is_space(*p)) p++;
+    return p;
+}
+
+// Parses a decimal float at p (no leading blanks), returns the end of the number or nullptr if there is none
+const char *parse_double(const char *p, const char *end, double &out)
+{
+    const char *start = p;
+    bool neg = false;
+    if (p < end && (*p == '-' || *p == '+')) neg = *p++ == '-';
+
+    uint64_t mant = 0;
+    int sig = 0;  // significant digits in mant
+    int exp10 = 0;
+    bool digits = false, exact = true;
+
+    for (; p < end && is_digit(*p); p++, digits = true) {
+        if (sig < 19) {
+            mant = mant * 10 + (*p - '0');
+            sig += mant != 0;
+        } else {
+            exp10++;
+            exact = exact && *p == '0';
+        }
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && is_digit(*p); p++, digits = true) {
+            if (sig < 19) {
+                mant = mant * 10 + (*p - '0');
+                sig += mant != 0;
+                exp10--;
+            } else {
+                exact = exact && *p == '0';
+            }
+        }
+    }
+    if (!digits) return nullptr;
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        bool eneg = false;
+        if (q < end && (*q == '-' || *q == '+')) eneg = *q++ == '-';
+        if (q < end && is_digit(*q)) {
+            int e = 0;
+            for (; q < end && is_digit(*q); q++) e = std::min(e * 10 + (*q - '0'), 100000);
+            exp10 += eneg ? -e : e;
+            p = q;
+        }
+    }
+
+    if (exact && mant <= (uint64_t(1) << 53) && exp10 >= -22 && exp10 <= 22) {
+        const double m = static_cast<double>(mant);
+        out = exp10 < 0 ? m / exact_pow10[-exp10] : m * exact_pow10[exp10];
+        if (neg) out = -out;
+        return p;
+    }
+
+    // --> slow path, from_chars reads the token where it lies whatever its length and rounds like strtod. Out of
+    //     range it leaves out alone, strtod's infinity or zero is set here instead
+    const char *num = *start == '+' ? start + 1 : start;
+    const std::from_chars_result r = std::from_chars(num, p, out);
+    if (r.ec == std::errc::result_out_of_range) out = (neg ? -1 : 1) * (sig + exp10 > 0 ? HUGE_VAL : 0.0);
+    else if (r.ec != std::errc()) return nullptr;
+    return p;
+}
+
+const char *parse_int(const char *p, const char *end, int &out)
+{
+    bool neg = false;
+    if (p < end && (*p == '-' || *p == '+')) neg = *p++ == '-';
+    if (p == end || !is_digit(*p)) return nullptr;
+    // saturates at INT_MAX, an index that big fails parse_obj()'s range check instead of overflowing
+    long long v = 0;
+    for (; p < end && is_digit(*p); p++) v = std::min<long long>(v * 10 + (*p - '0'), INT_MAX);
+    out = static_cast<int>(neg ? -v : v);
+    return p;
+}
+
+// Reads up to n blank separated floats into v, missing ones are left as they are
+template <typename V>
+void parse_floats(const char *p, const char *end, V &v, const size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        double d;
+        const char *q = parse_double(skip_space(p, end), end, d);
+        if (!q) return;
+        v[i] = d;
+        p = q;
+    }
+}
+
+// "f v/t/n v/t/n v/t/n", returns the number of complete corners
+int parse_face(const char *p, const char *end, ObjMesh &mesh)
+{
+    int cnt = 0;
+    while (true) {
+        int f, t, n;
+        p = skip_space(p, end);
+        if (!(p = parse_int(p, end, f)) || p == end || is_space(*p)) break;
+        if (!(p = parse_int(p + 1, end, t)) || p == end || is_space(*p)) break;
+        if (!(p = parse_int(p + 1, end, n))) break;
+        mesh.facet_vrt.push_back(f - 1);
+        mesh.facet_tex.push_back(t - 1);
+        mesh.facet_nrm.push_back(n - 1);
+        cnt++;
+    }
+    return cnt;
+}
+
+void parse_chunk(const char *p, const char *end, ObjChunk &chunk)
+{
+    ObjMesh &mesh = chunk.mesh;
+    while (p < end) {
+        const char *eol = static_cast<const char *>(std::memchr(p, '\n', end - p));
+        if (!eol) eol = end;
+        const size_t len = eol - p;
+
+        if (len >= 2 && p[0] == 'v' && p[1] == ' ') {
+            vec3f v;
+            parse_floats(p + 2, eol, v, 3);
+            mesh.verts.push_back(v);
+        } else if (len >= 3 && p[0] == 'v' && p[1] == 'n' && p[2] == ' ') {
+            vec3f n;
+            parse_floats(p + 3, eol, n, 3);
+            mesh.norms.push_back(n.normalize());
+        } else if (len >= 3 && p[0] == 'v' && p[1] == 't' && p[2] == ' ') {
+            vec2f uv;
+            parse_floats(p + 3, eol, uv, 2);
+            mesh.uv.push_back(uv);
+        } else if (len >= 2 && p[0] == 'f' && p[1] == ' ') {
+            if (parse_face(p + 2, eol, mesh) != 3) {
+                chunk.error = true;
+                return;
+            }
+        }
+        p = eol + 1;
+    }
+}
+
+// Faces before the first one with a vertex, uv or normal index outside its array
+size_t faces_in_range(const ObjMesh &mesh)
+{
+    auto in = [](const int i, const size_t n) { return i >= 0 && static_cast<size_t>(i) < n; };
+    const size_t nfaces = mesh.facet_vrt.size() / 3;
+    for (size_t i = 0; i < nfaces * 3; i++)
+        if (!in(mesh.facet_vrt[i], mesh.verts.size()) || !in(mesh.facet_tex[i], mesh.uv.size()) ||
+            !in(mesh.facet_nrm[i], mesh.norms.size()))
+            return i / 3;
+    return nfaces;
+}
+
+template <typename T>
+void append(std::vector<T> &dst, const std::vector<T> &src)
+{
+    dst.insert(dst.end(), src.begin(), src.end());
+}
+
+}  // namespace
+
+bool parse_obj(const std::string &filename, ObjMesh &mesh)
+{
+    MappedFile file(filename);
+    if (!file.is_open()) return false;
+    const char *data = file.data();
+    const size_t size = file.size();
+
+    // --> chunk boundaries, each one moved forward to the start of the next line
+    const size_t nthreads = std::max(1u, std::thread::hardware_concurrency());
+    const size_t nchunks = std::clamp<size_t>(size / min_chunk_bytes, 1, nthreads * 4);
+    std::vector<size_t> bounds(nchunks + 1, size);
+    bounds[0] = 0;
+    for (size_t i = 1; i < nchunks; i++) {
+        size_t b = std::max(bounds[i - 1], size / nchunks * i);
+        const void *nl = b < size ? std::memchr(data + b, '\n', size - b) : nullptr;
+        bounds[i] = nl ? static_cast<const char *>(nl) - data + 1 : size;
+    }
+
+    std::vector<ObjChunk> chunks(nchunks);
+    auto parse = [&](size_t i) { parse_chunk(data + bounds[i], data + bounds[i + 1], chunks[i]); };
+    if (nchunks == 1) {
+        parse(0);
+    } else {
+        ThreadPool pool(std::min(nthreads, nchunks));
+        pool.parallel_for(nchunks, parse);
+    }
+
+    // --> merge in file order, stopping after the first chunk that hit a bad face
+    size_t last = 0;
+    while (last + 1 < nchunks && !chunks[last].error) last++;
+    if (nchunks == 1) {
+        mesh = std::move(chunks[0].mesh);
+    } else {
+        size_t nv = 0, nt = 0, nn = 0, nf = 0;
+        for (size_t i = 0; i <= last; i++) {
+            nv += chunks[i].mesh.verts.size();
+            nt += chunks[i].mesh.uv.size();
+            nn += chunks[i].mesh.norms.size();
+            nf += chunks[i].mesh.facet_vrt.size();
+        }
+        mesh = ObjMesh();
+        mesh.verts.reserve(nv);
+        mesh.uv.reserve(nt);
+        mesh.norms.reserve(nn);
+        mesh.facet_vrt.reserve(nf);
+        mesh.facet_tex.reserve(nf);
+        mesh.facet_nrm.reserve(nf);
+        for (size_t i = 0; i <= last; i++) {
+            const ObjMesh &c = chunks[i].mesh;
+            append(mesh.verts, c.verts);
+            append(mesh.uv, c.uv);
+            append(mesh.norms, c.norms);
+            append(mesh.facet_vrt, c.facet_vrt);
+            append(mesh.facet_tex, c.facet_tex);
+            append(mesh.facet_nrm, c.facet_nrm);
+        }
+    }
+
+    // --> every index has to point into its array once all of them are known, like the mesh cache checks on open.
+    //     Relative (negative) indices aren't supported and fail here too
+    const size_t good = faces_in_range(mesh);
+    if (good * 3 < mesh.facet_vrt.size()) {
+        std::cerr << "Error: face " << good + 1 << " of the obj file indexes a vertex, uv or normal that doesn't exist"
+                  << std::endl;
+        mesh.facet_vrt.resize(good * 3);
+        mesh.facet_tex.resize(good * 3);
+        mesh.facet_nrm.resize(good * 3);
+        return false;
+    }
+    if (chunks[last].error) {
+        std::cerr << "Error: the obj file is supposed to be triangulated" << std::endl;
+        return false;
+    }
+    return true;
+}
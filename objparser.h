@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "geometry.h"
+
+// Raw arrays of a triangulated OBJ file, indices are 0 based
+struct ObjMesh
+{
+    std::vector<vec3f> verts;
+    std::vector<vec2f> uv;
+    std::vector<vec3f> norms;  // normalized
+    std::vector<int> facet_vrt, facet_tex, facet_nrm;
+};
+
+/*
+    OBJ loader for the subset Model understands : v, vt, vn and triangular "f v/t/n" faces, anything else is skipped
+
+    --> the file is memory mapped and cut into chunks at line boundaries, big files have their chunks parsed in
+        parallel on a thread pool, then the per chunk arrays are concatenated in file order
+    --> numbers go through a hand written parser, floats take the exact fast path (at most 19 significant digits
+        with a mantissa below 2^53 and a power of ten up to 1e22 is one correctly rounded multiply or divide) and
+        anything else falls back to std::from_chars on the token in place (any length, rounded like strtod), so
+        the values are identical to what iostream reads
+    --> returns false if the file can't be opened, a face isn't a triangle or a face index (1 based, absolute)
+        points outside the v, vt or vn read from the whole file (the latter two are reported on stderr), in that
+        case mesh holds whatever came before the bad face
+*/
+bool parse_obj(const std::string &filename, ObjMesh &mesh);
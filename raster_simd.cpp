@@ -0,0 +1,967 @@
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "triangle.h"
+#include "shadow.h"
+#include "msaa.h"
+
+#if RASTER_SIMD
+#include <immintrin.h>
+#endif
+
+static RasterKernel detect_kernel()
+{
+    if (const char *env = std::getenv("RASTER_KERNEL")) {
+        const std::string name(env);
+        if (name == "scalar") return RasterKernel::Scalar;
+        if (name == "sse41") return RasterKernel::SSE41;
+        if (name == "avx2") return RasterKernel::AVX2;
+    }
+#if RASTER_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return RasterKernel::AVX2;
+    if (__builtin_cpu_supports("sse4.1")) return RasterKernel::SSE41;
+#endif
+    return RasterKernel::Scalar;
+}
+
+static RasterKernel active_kernel = detect_kernel();
+
+RasterKernel raster_kernel() { return active_kernel; }
+
+void set_raster_kernel(const RasterKernel k) { active_kernel = k; }
+
+const char *raster_kernel_name(const RasterKernel k)
+{
+    switch (k) {
+        case RasterKernel::AVX2: return "avx2";
+        case RasterKernel::SSE41: return "sse41";
+        default: return "scalar";
+    }
+}
+
+#if RASTER_SIMD
+
+// Clipped pixel range of a triangle, empty when xmin > xmax or ymin > ymax
+struct Span
+{
+    int xmin, xmax, ymin, ymax;
+    Span(const TriangleSetup &t, const Tile &clip)
+        : xmin(std::max(clip.x0, t.xmin)), xmax(std::min(clip.x1, t.xmax)),
+          ymin(std::max(clip.y0, t.ymin)), ymax(std::min(clip.y1, t.ymax))
+    {}
+    bool empty() const { return xmin > xmax || ymin > ymax; }
+};
+
+// Writes the fragment color of every pixel whose bit is set in `hits`, pixel i of the block is (x + i, y) at fb + i*bpp
+template <typename S>
+static inline void shade_block(int hits, std::uint8_t *fb, const int bpp, const int x, const int y, const double *u,
+                               const double *v, const S &shader, const typename S::Bound &bound)
+{
+    while (hits) {
+        const int i = __builtin_ctz(hits);
+        hits &= hits - 1;
+        const std::uint32_t c = shader.fragment(bound, x + i, y, u[i], v[i]);
+        memcpy(fb + i * bpp, &c, bpp);
+    }
+}
+
+// Blocks that stick out of the right border of the image can't be loaded whole, those go one pixel at a time
+template <typename T>
+static inline int ztest_lanes(T *zp, const int cover, const double *enc, const int n)
+{
+    int hits = 0;
+    for (int i = 0; i < n; i++) {
+        if ((cover >> i & 1) && zp[i] < enc[i]) {
+            zp[i] = static_cast<T>(enc[i]);
+            hits |= 1 << i;
+        }
+    }
+    return hits;
+}
+
+/*
+	Depth loads and stores, 8 pixels as two halves of 4 doubles for AVX2 and 4 pixels as two halves of 2
+	doubles for SSE4.1
+*/
+template <DepthBuffer::Format F> struct SimdDepth;
+
+template <> struct SimdDepth<DepthBuffer::FLOAT32>
+{
+    __attribute__((target("avx2"))) static void load8(const float *p, __m256d &lo, __m256d &hi)
+    {
+        const __m256 v = _mm256_loadu_ps(p);
+        lo = _mm256_cvtps_pd(_mm256_castps256_ps128(v));
+        hi = _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1));
+    }
+    __attribute__((target("avx2"))) static void store8(float *p, const __m256d lo, const __m256d hi)
+    {
+        _mm256_storeu_ps(p, _mm256_set_m128(_mm256_cvtpd_ps(hi), _mm256_cvtpd_ps(lo)));
+    }
+    __attribute__((target("sse4.1"))) static void load4(const float *p, __m128d &lo, __m128d &hi)
+    {
+        const __m128 v = _mm_loadu_ps(p);
+        lo = _mm_cvtps_pd(v);
+        hi = _mm_cvtps_pd(_mm_movehl_ps(v, v));
+    }
+    __attribute__((target("sse4.1"))) static void store4(float *p, const __m128d lo, const __m128d hi)
+    {
+        _mm_storeu_ps(p, _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi)));
+    }
+};
+
+template <> struct SimdDepth<DepthBuffer::UNORM24>
+{
+    __attribute__((target("avx2"))) static void load8(const std::uint32_t *p, __m256d &lo, __m256d &hi)
+    {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        lo = _mm256_cvtepi32_pd(_mm256_castsi256_si128(v));
+        hi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1));
+    }
+    __attribute__((target("avx2"))) static void store8(std::uint32_t *p, const __m256d lo, const __m256d hi)
+    {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(p),
+                            _mm256_set_m128i(_mm256_cvtpd_epi32(hi), _mm256_cvtpd_epi32(lo)));
+    }
+    __attribute__((target("sse4.1"))) static void load4(const std::uint32_t *p, __m128d &lo, __m128d &hi)
+    {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        lo = _mm_cvtepi32_pd(v);
+        hi = _mm_cvtepi32_pd(_mm_srli_si128(v, 8));
+    }
+    __attribute__((target("sse4.1"))) static void store4(std::uint32_t *p, const __m128d lo, const __m128d hi)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(p),
+                         _mm_unpacklo_epi64(_mm_cvtpd_epi32(lo), _mm_cvtpd_epi32(hi)));
+    }
+};
+
+template <> struct SimdDepth<DepthBuffer::UNORM16>
+{
+    __attribute__((target("avx2"))) static void load8(const std::uint16_t *p, __m256d &lo, __m256d &hi)
+    {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        lo = _mm256_cvtepi32_pd(_mm_cvtepu16_epi32(v));
+        hi = _mm256_cvtepi32_pd(_mm_cvtepu16_epi32(_mm_srli_si128(v, 8)));
+    }
+    __attribute__((target("avx2"))) static void store8(std::uint16_t *p, const __m256d lo, const __m256d hi)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(p),
+                         _mm_packus_epi32(_mm256_cvtpd_epi32(lo), _mm256_cvtpd_epi32(hi)));
+    }
+    __attribute__((target("sse4.1"))) static void load4(const std::uint16_t *p, __m128d &lo, __m128d &hi)
+    {
+        const __m128i v = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p)));
+        lo = _mm_cvtepi32_pd(v);
+        hi = _mm_cvtepi32_pd(_mm_srli_si128(v, 8));
+    }
+    __attribute__((target("sse4.1"))) static void store4(std::uint16_t *p, const __m128d lo, const __m128d hi)
+    {
+        const __m128i v = _mm_unpacklo_epi64(_mm_cvtpd_epi32(lo), _mm_cvtpd_epi32(hi));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(p), _mm_packus_epi32(v, v));
+    }
+};
+
+/*
+	8 pixels per step, as two halves of 4 doubles (lo = pixels 0..3, hi = pixels 4..7)
+	planes are w0, w1, w2, z and for shaders that use uv u, v
+*/
+template <typename S, DepthBuffer::Format F>
+__attribute__((target("avx2"))) static bool kernel_avx2(const S &shader, const typename S::Face &face,
+                                                        const TriangleSetup &t, DepthBuffer &zb, TGAImage &image,
+                                                        const Tile &clip)
+{
+    using T = typename DepthStorage<F>::type;
+    const Span s(t, clip);
+    if (s.empty()) return false;
+
+    const int width = image.get_width();
+    const int bpp = image.get_bytespp();
+    std::uint8_t *buffer = image.buffer();
+    T *zbuffer = zb.data<T>();
+    const typename S::Bound bound = shader.bind(t, face);
+
+    constexpr int nplanes = S::uses_uv ? 6 : 4;
+    const Plane *planes[6] = {&t.w[0], &t.w[1], &t.w[2], &t.z, &t.u, &t.v};
+
+    const __m256d lane_lo = _mm256_set_pd(3, 2, 1, 0);
+    const __m256d lane_hi = _mm256_set_pd(7, 6, 5, 4);
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d first = _mm256_set1_pd(s.xmin), last = _mm256_set1_pd(s.xmax);
+    const __m256d znear = _mm256_set1_pd(zb.znear()), scale = _mm256_set1_pd(zb.scale());
+    const __m256d emin = _mm256_set1_pd(zb.lowest_encoded()), emax = _mm256_set1_pd(zb.max_encoded());
+
+    // blocks start on a multiple of 8, lanes in front of the span are masked out
+    const int xstart = s.xmin & ~7;
+
+    __m256d step[nplanes];
+    double row[nplanes];
+    for (int k = 0; k < nplanes; k++) {
+        step[k] = _mm256_set1_pd(8 * planes[k]->a);
+        row[k] = planes[k]->at(xstart, s.ymin);
+    }
+
+    alignas(32) double u[8] = {}, v[8] = {}, enc[8];
+    bool wrote = false;
+
+    for (int y = s.ymin; y <= s.ymax; y++) {
+        __m256d lo[nplanes], hi[nplanes];
+        for (int k = 0; k < nplanes; k++) {
+            const __m256d a = _mm256_set1_pd(planes[k]->a), r = _mm256_set1_pd(row[k]);
+            lo[k] = _mm256_add_pd(r, _mm256_mul_pd(a, lane_lo));
+            hi[k] = _mm256_add_pd(r, _mm256_mul_pd(a, lane_hi));
+        }
+        bool entered = false;
+
+        for (int x = xstart; x <= s.xmax; x += 8) {
+            const __m256d x0 = _mm256_set1_pd(x);
+            const __m256d px_lo = _mm256_add_pd(x0, lane_lo), px_hi = _mm256_add_pd(x0, lane_hi);
+            __m256d in_lo = _mm256_and_pd(_mm256_cmp_pd(px_lo, first, _CMP_GE_OQ), _mm256_cmp_pd(px_lo, last, _CMP_LE_OQ));
+            __m256d in_hi = _mm256_and_pd(_mm256_cmp_pd(px_hi, first, _CMP_GE_OQ), _mm256_cmp_pd(px_hi, last, _CMP_LE_OQ));
+            for (int k = 0; k < 3; k++) {
+                in_lo = _mm256_and_pd(in_lo, _mm256_cmp_pd(lo[k], zero, _CMP_GE_OQ));
+                in_hi = _mm256_and_pd(in_hi, _mm256_cmp_pd(hi[k], zero, _CMP_GE_OQ));
+            }
+            const int cover = _mm256_movemask_pd(in_lo) | (_mm256_movemask_pd(in_hi) << 4);
+
+            if (cover) {
+                entered = true;
+                T *zp = zbuffer + x + y * width;
+                __m256d z_lo = _mm256_round_pd(lo[3], _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+                __m256d z_hi = _mm256_round_pd(hi[3], _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+                if (F != DepthBuffer::FLOAT32) {  // same math as DepthBuffer::encode()
+                    z_lo = _mm256_mul_pd(_mm256_sub_pd(z_lo, znear), scale);
+                    z_hi = _mm256_mul_pd(_mm256_sub_pd(z_hi, znear), scale);
+                    z_lo = _mm256_round_pd(_mm256_min_pd(_mm256_max_pd(z_lo, emin), emax), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+                    z_hi = _mm256_round_pd(_mm256_min_pd(_mm256_max_pd(z_hi, emin), emax), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+                }
+
+                int hits;
+                if (x + 8 <= width) {
+                    __m256d old_lo, old_hi;
+                    SimdDepth<F>::load8(zp, old_lo, old_hi);
+                    const __m256d pass_lo = _mm256_and_pd(in_lo, _mm256_cmp_pd(old_lo, z_lo, _CMP_LT_OQ));
+                    const __m256d pass_hi = _mm256_and_pd(in_hi, _mm256_cmp_pd(old_hi, z_hi, _CMP_LT_OQ));
+                    SimdDepth<F>::store8(zp, _mm256_blendv_pd(old_lo, z_lo, pass_lo), _mm256_blendv_pd(old_hi, z_hi, pass_hi));
+                    hits = _mm256_movemask_pd(pass_lo) | (_mm256_movemask_pd(pass_hi) << 4);
+                } else {
+                    _mm256_store_pd(enc, z_lo);
+                    _mm256_store_pd(enc + 4, z_hi);
+                    hits = ztest_lanes(zp, cover, enc, width - x);
+                }
+
+                if (hits) {
+                    wrote = true;
+                    if constexpr (S::uses_uv) {
+                        _mm256_store_pd(u, lo[4]);
+                        _mm256_store_pd(u + 4, hi[4]);
+                        _mm256_store_pd(v, lo[5]);
+                        _mm256_store_pd(v + 4, hi[5]);
+                    }
+                    shade_block(hits, buffer + (x + y * width) * bpp, bpp, x, y, u, v, shader, bound);
+                }
+            } else if (entered) {
+                break;
+            }
+
+            for (int k = 0; k < nplanes; k++) {
+                lo[k] = _mm256_add_pd(lo[k], step[k]);
+                hi[k] = _mm256_add_pd(hi[k], step[k]);
+            }
+        }
+
+        for (int k = 0; k < nplanes; k++) row[k] += planes[k]->b;
+    }
+    return wrote;
+}
+
+/*
+	4 pixels per step, as two halves of 2 doubles
+*/
+template <typename S, DepthBuffer::Format F>
+__attribute__((target("sse4.1"))) static bool kernel_sse41(const S &shader, const typename S::Face &face,
+                                                           const TriangleSetup &t, DepthBuffer &zb, TGAImage &image,
+                                                           const Tile &clip)
+{
+    using T = typename DepthStorage<F>::type;
+    const Span s(t, clip);
+    if (s.empty()) return false;
+
+    const int width = image.get_width();
+    const int bpp = image.get_bytespp();
+    std::uint8_t *buffer = image.buffer();
+    T *zbuffer = zb.data<T>();
+    const typename S::Bound bound = shader.bind(t, face);
+
+    constexpr int nplanes = S::uses_uv ? 6 : 4;
+    const Plane *planes[6] = {&t.w[0], &t.w[1], &t.w[2], &t.z, &t.u, &t.v};
+
+    const __m128d lane_lo = _mm_set_pd(1, 0);
+    const __m128d lane_hi = _mm_set_pd(3, 2);
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d first = _mm_set1_pd(s.xmin), last = _mm_set1_pd(s.xmax);
+    const __m128d znear = _mm_set1_pd(zb.znear()), scale = _mm_set1_pd(zb.scale());
+    const __m128d emin = _mm_set1_pd(zb.lowest_encoded()), emax = _mm_set1_pd(zb.max_encoded());
+
+    const int xstart = s.xmin & ~3;
+
+    __m128d step[nplanes];
+    double row[nplanes];
+    for (int k = 0; k < nplanes; k++) {
+        step[k] = _mm_set1_pd(4 * planes[k]->a);
+        row[k] = planes[k]->at(xstart, s.ymin);
+    }
+
+    alignas(16) double u[4] = {}, v[4] = {}, enc[4];
+    bool wrote = false;
+
+    for (int y = s.ymin; y <= s.ymax; y++) {
+        __m128d lo[nplanes], hi[nplanes];
+        for (int k = 0; k < nplanes; k++) {
+            const __m128d a = _mm_set1_pd(planes[k]->a), r = _mm_set1_pd(row[k]);
+            lo[k] = _mm_add_pd(r, _mm_mul_pd(a, lane_lo));
+            hi[k] = _mm_add_pd(r, _mm_mul_pd(a, lane_hi));
+        }
+        bool entered = false;
+
+        for (int x = xstart; x <= s.xmax; x += 4) {
+            const __m128d x0 = _mm_set1_pd(x);
+            const __m128d px_lo = _mm_add_pd(x0, lane_lo), px_hi = _mm_add_pd(x0, lane_hi);
+            __m128d in_lo = _mm_and_pd(_mm_cmpge_pd(px_lo, first), _mm_cmple_pd(px_lo, last));
+            __m128d in_hi = _mm_and_pd(_mm_cmpge_pd(px_hi, first), _mm_cmple_pd(px_hi, last));
+            for (int k = 0; k < 3; k++) {
+                in_lo = _mm_and_pd(in_lo, _mm_cmpge_pd(lo[k], zero));
+                in_hi = _mm_and_pd(in_hi, _mm_cmpge_pd(hi[k], zero));
+            }
+            const int cover = _mm_movemask_pd(in_lo) | (_mm_movemask_pd(in_hi) << 2);
+
+            if (cover) {
+                entered = true;
+                T *zp = zbuffer + x + y * width;
+                __m128d z_lo = _mm_round_pd(lo[3], _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+                __m128d z_hi = _mm_round_pd(hi[3], _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+                if (F != DepthBuffer::FLOAT32) {
+                    z_lo = _mm_mul_pd(_mm_sub_pd(z_lo, znear), scale);
+                    z_hi = _mm_mul_pd(_mm_sub_pd(z_hi, znear), scale);
+                    z_lo = _mm_round_pd(_mm_min_pd(_mm_max_pd(z_lo, emin), emax), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+                    z_hi = _mm_round_pd(_mm_min_pd(_mm_max_pd(z_hi, emin), emax), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+                }
+
+                int hits;
+                if (x + 4 <= width) {
+                    __m128d old_lo, old_hi;
+                    SimdDepth<F>::load4(zp, old_lo, old_hi);
+                    const __m128d pass_lo = _mm_and_pd(in_lo, _mm_cmplt_pd(old_lo, z_lo));
+                    const __m128d pass_hi = _mm_and_pd(in_hi, _mm_cmplt_pd(old_hi, z_hi));
+                    SimdDepth<F>::store4(zp, _mm_blendv_pd(old_lo, z_lo, pass_lo), _mm_blendv_pd(old_hi, z_hi, pass_hi));
+                    hits = _mm_movemask_pd(pass_lo) | (_mm_movemask_pd(pass_hi) << 2);
+                } else {
+                    _mm_store_pd(enc, z_lo);
+                    _mm_store_pd(enc + 2, z_hi);
+                    hits = ztest_lanes(zp, cover, enc, width - x);
+                }
+
+                if (hits) {
+                    wrote = true;
+                    if constexpr (S::uses_uv) {
+                        _mm_store_pd(u, lo[4]);
+                        _mm_store_pd(u + 2, hi[4]);
+                        _mm_store_pd(v, lo[5]);
+                        _mm_store_pd(v + 2, hi[5]);
+                    }
+                    shade_block(hits, buffer + (x + y * width) * bpp, bpp, x, y, u, v, shader, bound);
+                }
+            } else if (entered) {
+                break;
+            }
+
+            for (int k = 0; k < nplanes; k++) {
+                lo[k] = _mm_add_pd(lo[k], step[k]);
+                hi[k] = _mm_add_pd(hi[k], step[k]);
+            }
+        }
+
+        for (int k = 0; k < nplanes; k++) row[k] += planes[k]->b;
+    }
+    return wrote;
+}
+
+/*
+	Depth only kernels (shadow maps) : the kernels above without the fragment stage and the uv planes
+
+	--> with no pixels to shade there are no hit masks to walk, a block is one masked blend and store
+	--> instead of walking in from the left of the bbox until the triangle is entered, every row starts at the
+		block where the edge functions say coverage can begin and stops where it must end (RowSpans), which is
+		where long thin triangles spend most of their time otherwise
+	--> RowSpans also gives the pixels that are inside by a margin. A run of blocks that lies entirely there skips
+		the edge tests and steps z alone, which fits in registers where all four planes don't, and the edge planes
+		jump over the run at its end. In a shadow map most blocks of a triangle are in such runs
+*/
+
+/*
+	Where a triangle's rows begin and end, without dividing per row
+
+	--> edge k crosses 0 on row y at x = -(b*y + c)/a, a line in y, so each row is a multiply-add per edge
+	--> span() gives the pixels of row y inside [xmin, xmax] where all three edge functions can be >= 0, with a
+		pixel of slack on both sides so rounding can never drop a pixel the per block test would keep, and
+		[inner_first, inner_last] where all three surely are (empty when inner_first > inner_last)
+*/
+struct RowSpans
+{
+    // how far inside the inner pixels are, far above what the kernels lose stepping the planes across a row
+    static constexpr double margin = 1e-7;
+
+    const TriangleSetup &t;
+    double cross0[3], cross_dy[3], inner_dx[3];
+
+    explicit RowSpans(const TriangleSetup &t) : t(t)
+    {
+        for (int k = 0; k < 3; k++) {
+            const double a = t.w[k].a;
+            if (a == 0) continue;
+            cross0[k] = -t.w[k].c / a;
+            cross_dy[k] = -t.w[k].b / a;
+            inner_dx[k] = margin / a;
+        }
+    }
+
+    // false when no pixel of the row can be covered
+    __attribute__((always_inline)) bool span(const int y, const int xmin, const int xmax, int &first, int &last,
+                                             int &inner_first, int &inner_last) const
+    {
+        double lo = xmin, hi = xmax, inner_lo = xmin, inner_hi = xmax;
+        for (int k = 0; k < 3; k++) {
+            const double a = t.w[k].a;
+            if (a == 0) {
+                const double r = t.w[k].b * y + t.w[k].c;
+                if (r < 0) return false;
+                if (r < margin) inner_hi = xmin - 1;
+                continue;
+            }
+            const double x = cross0[k] + cross_dy[k] * y;
+            if (a > 0) {
+                lo = std::max(lo, x - 1);
+                inner_lo = std::max(inner_lo, x + inner_dx[k]);
+            } else {
+                hi = std::min(hi, x + 1);
+                inner_hi = std::min(inner_hi, x + inner_dx[k]);
+            }
+        }
+        if (!(lo <= hi)) return false;
+        first = static_cast<int>(std::floor(lo));
+        last = static_cast<int>(std::ceil(hi));
+        inner_first = static_cast<int>(std::ceil(std::min(inner_lo, xmax + 1.0)));
+        inner_last = static_cast<int>(std::floor(std::max(inner_hi, xmin - 1.0)));
+        return true;
+    }
+};
+
+// Stored depth of 8 pixels from their interpolated z, as raster_scalar computes it (truncated, then encoded)
+template <DepthBuffer::Format F>
+__attribute__((target("avx2"), always_inline)) static inline void encode8(__m256d &z_lo, __m256d &z_hi,
+                                                                         const DepthBuffer &zb)
+{
+    z_lo = _mm256_round_pd(z_lo, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    z_hi = _mm256_round_pd(z_hi, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    if (F != DepthBuffer::FLOAT32) {
+        const __m256d znear = _mm256_set1_pd(zb.znear()), scale = _mm256_set1_pd(zb.scale());
+        const __m256d emin = _mm256_set1_pd(zb.lowest_encoded()), emax = _mm256_set1_pd(zb.max_encoded());
+        z_lo = _mm256_mul_pd(_mm256_sub_pd(z_lo, znear), scale);
+        z_hi = _mm256_mul_pd(_mm256_sub_pd(z_hi, znear), scale);
+        z_lo = _mm256_round_pd(_mm256_min_pd(_mm256_max_pd(z_lo, emin), emax), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        z_hi = _mm256_round_pd(_mm256_min_pd(_mm256_max_pd(z_hi, emin), emax), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    }
+}
+
+// Depth test of 8 whole pixels at zp, the ones in the masks that pass are stored. True when any did
+template <DepthBuffer::Format F>
+__attribute__((target("avx2"), always_inline)) static inline bool depth_test8(typename DepthStorage<F>::type *zp,
+                                                                             const __m256d z_lo, const __m256d z_hi,
+                                                                             const __m256d in_lo, const __m256d in_hi)
+{
+    __m256d old_lo, old_hi;
+    SimdDepth<F>::load8(zp, old_lo, old_hi);
+    const __m256d pass_lo = _mm256_and_pd(in_lo, _mm256_cmp_pd(old_lo, z_lo, _CMP_LT_OQ));
+    const __m256d pass_hi = _mm256_and_pd(in_hi, _mm256_cmp_pd(old_hi, z_hi, _CMP_LT_OQ));
+    if (!_mm256_movemask_pd(_mm256_or_pd(pass_lo, pass_hi))) return false;
+    SimdDepth<F>::store8(zp, _mm256_blendv_pd(old_lo, z_lo, pass_lo), _mm256_blendv_pd(old_hi, z_hi, pass_hi));
+    return true;
+}
+
+template <DepthBuffer::Format F>
+__attribute__((target("avx2"))) static bool depth_kernel_avx2(const TriangleSetup &t, DepthBuffer &zb,
+                                                              const Tile &clip)
+{
+    using T = typename DepthStorage<F>::type;
+    const Span s(t, clip);
+    if (s.empty()) return false;
+
+    const int width = zb.width();
+    T *zbuffer = zb.data<T>();
+    const Plane *planes[4] = {&t.w[0], &t.w[1], &t.w[2], &t.z};
+    const RowSpans rows(t);
+
+    const __m256d lane_lo = _mm256_set_pd(3, 2, 1, 0);
+    const __m256d lane_hi = _mm256_set_pd(7, 6, 5, 4);
+    const __m256d zero = _mm256_setzero_pd(), all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+    const __m256d first = _mm256_set1_pd(s.xmin), last = _mm256_set1_pd(s.xmax);
+
+    __m256d step[4];
+    for (int k = 0; k < 4; k++) step[k] = _mm256_set1_pd(8 * planes[k]->a);
+
+    alignas(32) double enc[8];
+    bool wrote = false;
+
+    for (int y = s.ymin; y <= s.ymax; y++) {
+        int x0, x1, inner0, inner1;
+        if (!rows.span(y, s.xmin, s.xmax, x0, x1, inner0, inner1)) continue;
+        x0 &= ~7;
+
+        __m256d lo[4], hi[4];
+        for (int k = 0; k < 4; k++) {
+            const __m256d a = _mm256_set1_pd(planes[k]->a), r = _mm256_set1_pd(planes[k]->at(x0, y));
+            lo[k] = _mm256_add_pd(r, _mm256_mul_pd(a, lane_lo));
+            hi[k] = _mm256_add_pd(r, _mm256_mul_pd(a, lane_hi));
+        }
+
+        int x = x0;
+        while (x <= x1) {
+            if (x >= inner0 && x + 7 <= inner1) {
+                // run of blocks inside the triangle : only z is stepped along it, the edges jump to its end after
+                const int start = x;
+                __m256d z_lo = lo[3], z_hi = hi[3];
+                for (; x + 7 <= inner1; x += 8) {
+                    __m256d e_lo = z_lo, e_hi = z_hi;
+                    encode8<F>(e_lo, e_hi, zb);
+                    if (depth_test8<F>(zbuffer + x + y * width, e_lo, e_hi, all, all)) wrote = true;
+                    z_lo = _mm256_add_pd(z_lo, step[3]);
+                    z_hi = _mm256_add_pd(z_hi, step[3]);
+                }
+                lo[3] = z_lo;
+                hi[3] = z_hi;
+                const __m256d blocks = _mm256_set1_pd((x - start) / 8);
+                for (int k = 0; k < 3; k++) {
+                    lo[k] = _mm256_add_pd(lo[k], _mm256_mul_pd(step[k], blocks));
+                    hi[k] = _mm256_add_pd(hi[k], _mm256_mul_pd(step[k], blocks));
+                }
+                continue;
+            }
+
+            const __m256d px = _mm256_set1_pd(x);
+            const __m256d px_lo = _mm256_add_pd(px, lane_lo), px_hi = _mm256_add_pd(px, lane_hi);
+            __m256d in_lo = _mm256_and_pd(_mm256_cmp_pd(px_lo, first, _CMP_GE_OQ), _mm256_cmp_pd(px_lo, last, _CMP_LE_OQ));
+            __m256d in_hi = _mm256_and_pd(_mm256_cmp_pd(px_hi, first, _CMP_GE_OQ), _mm256_cmp_pd(px_hi, last, _CMP_LE_OQ));
+            for (int k = 0; k < 3; k++) {
+                in_lo = _mm256_and_pd(in_lo, _mm256_cmp_pd(lo[k], zero, _CMP_GE_OQ));
+                in_hi = _mm256_and_pd(in_hi, _mm256_cmp_pd(hi[k], zero, _CMP_GE_OQ));
+            }
+            const int cover = _mm256_movemask_pd(in_lo) | (_mm256_movemask_pd(in_hi) << 4);
+
+            if (cover) {
+                T *zp = zbuffer + x + y * width;
+                __m256d z_lo = lo[3], z_hi = hi[3];
+                encode8<F>(z_lo, z_hi, zb);
+                if (x + 8 <= width) {
+                    if (depth_test8<F>(zp, z_lo, z_hi, in_lo, in_hi)) wrote = true;
+                } else {
+                    _mm256_store_pd(enc, z_lo);
+                    _mm256_store_pd(enc + 4, z_hi);
+                    if (ztest_lanes(zp, cover, enc, width - x)) wrote = true;
+                }
+            }
+
+            for (int k = 0; k < 4; k++) {
+                lo[k] = _mm256_add_pd(lo[k], step[k]);
+                hi[k] = _mm256_add_pd(hi[k], step[k]);
+            }
+            x += 8;
+        }
+    }
+    return wrote;
+}
+
+template <DepthBuffer::Format F>
+__attribute__((target("sse4.1"), always_inline)) static inline void encode4(__m128d &z_lo, __m128d &z_hi,
+                                                                           const DepthBuffer &zb)
+{
+    z_lo = _mm_round_pd(z_lo, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    z_hi = _mm_round_pd(z_hi, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    if (F != DepthBuffer::FLOAT32) {
+        const __m128d znear = _mm_set1_pd(zb.znear()), scale = _mm_set1_pd(zb.scale());
+        const __m128d emin = _mm_set1_pd(zb.lowest_encoded()), emax = _mm_set1_pd(zb.max_encoded());
+        z_lo = _mm_mul_pd(_mm_sub_pd(z_lo, znear), scale);
+        z_hi = _mm_mul_pd(_mm_sub_pd(z_hi, znear), scale);
+        z_lo = _mm_round_pd(_mm_min_pd(_mm_max_pd(z_lo, emin), emax), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        z_hi = _mm_round_pd(_mm_min_pd(_mm_max_pd(z_hi, emin), emax), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    }
+}
+
+template <DepthBuffer::Format F>
+__attribute__((target("sse4.1"), always_inline)) static inline bool depth_test4(typename DepthStorage<F>::type *zp,
+                                                                               const __m128d z_lo, const __m128d z_hi,
+                                                                               const __m128d in_lo, const __m128d in_hi)
+{
+    __m128d old_lo, old_hi;
+    SimdDepth<F>::load4(zp, old_lo, old_hi);
+    const __m128d pass_lo = _mm_and_pd(in_lo, _mm_cmplt_pd(old_lo, z_lo));
+    const __m128d pass_hi = _mm_and_pd(in_hi, _mm_cmplt_pd(old_hi, z_hi));
+    if (!_mm_movemask_pd(_mm_or_pd(pass_lo, pass_hi))) return false;
+    SimdDepth<F>::store4(zp, _mm_blendv_pd(old_lo, z_lo, pass_lo), _mm_blendv_pd(old_hi, z_hi, pass_hi));
+    return true;
+}
+
+template <DepthBuffer::Format F>
+__attribute__((target("sse4.1"))) static bool depth_kernel_sse41(const TriangleSetup &t, DepthBuffer &zb,
+                                                                 const Tile &clip)
+{
+    using T = typename DepthStorage<F>::type;
+    const Span s(t, clip);
+    if (s.empty()) return false;
+
+    const int width = zb.width();
+    T *zbuffer = zb.data<T>();
+    const Plane *planes[4] = {&t.w[0], &t.w[1], &t.w[2], &t.z};
+    const RowSpans rows(t);
+
+    const __m128d lane_lo = _mm_set_pd(1, 0);
+    const __m128d lane_hi = _mm_set_pd(3, 2);
+    const __m128d zero = _mm_setzero_pd(), all = _mm_castsi128_pd(_mm_set1_epi64x(-1));
+    const __m128d first = _mm_set1_pd(s.xmin), last = _mm_set1_pd(s.xmax);
+
+    __m128d step[4];
+    for (int k = 0; k < 4; k++) step[k] = _mm_set1_pd(4 * planes[k]->a);
+
+    alignas(16) double enc[4];
+    bool wrote = false;
+
+    for (int y = s.ymin; y <= s.ymax; y++) {
+        int x0, x1, inner0, inner1;
+        if (!rows.span(y, s.xmin, s.xmax, x0, x1, inner0, inner1)) continue;
+        x0 &= ~3;
+
+        __m128d lo[4], hi[4];
+        for (int k = 0; k < 4; k++) {
+            const __m128d a = _mm_set1_pd(planes[k]->a), r = _mm_set1_pd(planes[k]->at(x0, y));
+            lo[k] = _mm_add_pd(r, _mm_mul_pd(a, lane_lo));
+            hi[k] = _mm_add_pd(r, _mm_mul_pd(a, lane_hi));
+        }
+
+        int x = x0;
+        while (x <= x1) {
+            if (x >= inner0 && x + 3 <= inner1) {
+                const int start = x;
+                __m128d z_lo = lo[3], z_hi = hi[3];
+                for (; x + 3 <= inner1; x += 4) {
+                    __m128d e_lo = z_lo, e_hi = z_hi;
+                    encode4<F>(e_lo, e_hi, zb);
+                    if (depth_test4<F>(zbuffer + x + y * width, e_lo, e_hi, all, all)) wrote = true;
+                    z_lo = _mm_add_pd(z_lo, step[3]);
+                    z_hi = _mm_add_pd(z_hi, step[3]);
+                }
+                lo[3] = z_lo;
+                hi[3] = z_hi;
+                const __m128d blocks = _mm_set1_pd((x - start) / 4);
+                for (int k = 0; k < 3; k++) {
+                    lo[k] = _mm_add_pd(lo[k], _mm_mul_pd(step[k], blocks));
+                    hi[k] = _mm_add_pd(hi[k], _mm_mul_pd(step[k], blocks));
+                }
+                continue;
+            }
+
+            const __m128d px = _mm_set1_pd(x);
+            const __m128d px_lo = _mm_add_pd(px, lane_lo), px_hi = _mm_add_pd(px, lane_hi);
+            __m128d in_lo = _mm_and_pd(_mm_cmpge_pd(px_lo, first), _mm_cmple_pd(px_lo, last));
+            __m128d in_hi = _mm_and_pd(_mm_cmpge_pd(px_hi, first), _mm_cmple_pd(px_hi, last));
+            for (int k = 0; k < 3; k++) {
+                in_lo = _mm_and_pd(in_lo, _mm_cmpge_pd(lo[k], zero));
+                in_hi = _mm_and_pd(in_hi, _mm_cmpge_pd(hi[k], zero));
+            }
+            const int cover = _mm_movemask_pd(in_lo) | (_mm_movemask_pd(in_hi) << 2);
+
+            if (cover) {
+                T *zp = zbuffer + x + y * width;
+                __m128d z_lo = lo[3], z_hi = hi[3];
+                encode4<F>(z_lo, z_hi, zb);
+                if (x + 4 <= width) {
+                    if (depth_test4<F>(zp, z_lo, z_hi, in_lo, in_hi)) wrote = true;
+                } else {
+                    _mm_store_pd(enc, z_lo);
+                    _mm_store_pd(enc + 2, z_hi);
+                    if (ztest_lanes(zp, cover, enc, width - x)) wrote = true;
+                }
+            }
+
+            for (int k = 0; k < 4; k++) {
+                lo[k] = _mm_add_pd(lo[k], step[k]);
+                hi[k] = _mm_add_pd(hi[k], step[k]);
+            }
+            x += 4;
+        }
+    }
+    return wrote;
+}
+
+/*
+	Multisample kernels (see msaa.h) : raster_msaa_scalar() with the samples of a pixel as the vector
+
+	--> the pixel loop and its plane stepping are the scalar kernel's, a pixel that passes the reach test gets
+		its samples' edge tests, z and depth test done 4 (AVX2) or 2 (SSE4.1) samples per instruction
+	--> sample depths are floats, converted from the truncated double z like the scalar kernel does, and the 4
+		or 8 of a pixel are one load. Passing samples are written with masked stores (blends for SSE4.1)
+*/
+template <typename S, int N>
+__attribute__((target("avx2"))) static void msaa_kernel_avx2(const S &shader, const typename S::Face &face,
+                                                             const TriangleSetup &t, SampleTile &st, const Tile &clip)
+{
+    const Span s(t, clip);
+    if (s.empty()) return;
+    const typename S::Bound bound = shader.bind(t, face);
+    const SampleOffsets off(t, st);
+
+    constexpr int groups = N / 4;
+    __m256d ow[3][groups], oz[groups];
+    for (int g = 0; g < groups; g++) {
+        for (int k = 0; k < 3; k++) ow[k][g] = _mm256_load_pd(off.w[k] + 4 * g);
+        oz[g] = _mm256_load_pd(off.z + 4 * g);
+    }
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256i bits = _mm256_set_epi32(128, 64, 32, 16, 8, 4, 2, 1);
+
+    double w0_row = t.w[0].at(s.xmin, s.ymin), w1_row = t.w[1].at(s.xmin, s.ymin), w2_row = t.w[2].at(s.xmin, s.ymin);
+    double z_row = t.z.at(s.xmin, s.ymin), u_row = 0, v_row = 0;
+    if constexpr (S::uses_uv) {
+        u_row = t.u.at(s.xmin, s.ymin);
+        v_row = t.v.at(s.xmin, s.ymin);
+    }
+
+    for (int y = s.ymin; y <= s.ymax; y++) {
+        double w0 = w0_row, w1 = w1_row, w2 = w2_row;
+        double z = z_row, u = u_row, v = v_row;
+        bool entered = false;
+
+        for (int x = s.xmin; x <= s.xmax; x++) {
+            if (w0 + off.reach[0] >= 0 && w1 + off.reach[1] >= 0 && w2 + off.reach[2] >= 0) {
+                entered = true;
+                float *zp = st.depth(x, y);
+                const __m256d w0v = _mm256_set1_pd(w0), w1v = _mm256_set1_pd(w1), w2v = _mm256_set1_pd(w2);
+                const __m256d zv = _mm256_set1_pd(z);
+                __m128 pz[groups];
+                int cover = 0;
+                for (int g = 0; g < groups; g++) {
+                    __m256d in = _mm256_cmp_pd(_mm256_add_pd(w0v, ow[0][g]), zero, _CMP_GE_OQ);
+                    in = _mm256_and_pd(in, _mm256_cmp_pd(_mm256_add_pd(w1v, ow[1][g]), zero, _CMP_GE_OQ));
+                    in = _mm256_and_pd(in, _mm256_cmp_pd(_mm256_add_pd(w2v, ow[2][g]), zero, _CMP_GE_OQ));
+                    cover |= _mm256_movemask_pd(in) << 4 * g;
+                    pz[g] = _mm256_cvtpd_ps(_mm256_round_pd(_mm256_add_pd(zv, oz[g]), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC));
+                }
+
+                if (cover) {
+                    if constexpr (N == 8) {
+                        const __m256 z8 = _mm256_set_m128(pz[1], pz[0]);
+                        const int pass = cover & _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(zp), z8, _CMP_LT_OQ));
+                        if (pass) {
+                            const std::uint32_t c = shader.fragment(bound, x, y, u, v);
+                            const __m256i m = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(pass), bits), bits);
+                            _mm256_maskstore_ps(zp, m, z8);
+                            _mm256_maskstore_epi32(reinterpret_cast<int *>(st.color(x, y)), m, _mm256_set1_epi32(c));
+                        }
+                    } else {
+                        const int pass = cover & _mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps(zp), pz[0]));
+                        if (pass) {
+                            const std::uint32_t c = shader.fragment(bound, x, y, u, v);
+                            const __m128i b4 = _mm256_castsi256_si128(bits);
+                            const __m128i m = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(pass), b4), b4);
+                            _mm_maskstore_ps(zp, m, pz[0]);
+                            _mm_maskstore_epi32(reinterpret_cast<int *>(st.color(x, y)), m, _mm_set1_epi32(c));
+                        }
+                    }
+                }
+            } else if (entered) {
+                break;
+            }
+
+            w0 += t.w[0].a;
+            w1 += t.w[1].a;
+            w2 += t.w[2].a;
+            z += t.z.a;
+            if constexpr (S::uses_uv) {
+                u += t.u.a;
+                v += t.v.a;
+            }
+        }
+
+        w0_row += t.w[0].b;
+        w1_row += t.w[1].b;
+        w2_row += t.w[2].b;
+        z_row += t.z.b;
+        if constexpr (S::uses_uv) {
+            u_row += t.u.b;
+            v_row += t.v.b;
+        }
+    }
+}
+
+template <typename S, int N>
+__attribute__((target("sse4.1"))) static void msaa_kernel_sse41(const S &shader, const typename S::Face &face,
+                                                                const TriangleSetup &t, SampleTile &st,
+                                                                const Tile &clip)
+{
+    const Span s(t, clip);
+    if (s.empty()) return;
+    const typename S::Bound bound = shader.bind(t, face);
+    const SampleOffsets off(t, st);
+
+    constexpr int groups = N / 2;
+    __m128d ow[3][groups], oz[groups];
+    for (int g = 0; g < groups; g++) {
+        for (int k = 0; k < 3; k++) ow[k][g] = _mm_load_pd(off.w[k] + 2 * g);
+        oz[g] = _mm_load_pd(off.z + 2 * g);
+    }
+    const __m128d zero = _mm_setzero_pd();
+    const __m128i bits = _mm_set_epi32(8, 4, 2, 1);
+
+    double w0_row = t.w[0].at(s.xmin, s.ymin), w1_row = t.w[1].at(s.xmin, s.ymin), w2_row = t.w[2].at(s.xmin, s.ymin);
+    double z_row = t.z.at(s.xmin, s.ymin), u_row = 0, v_row = 0;
+    if constexpr (S::uses_uv) {
+        u_row = t.u.at(s.xmin, s.ymin);
+        v_row = t.v.at(s.xmin, s.ymin);
+    }
+
+    for (int y = s.ymin; y <= s.ymax; y++) {
+        double w0 = w0_row, w1 = w1_row, w2 = w2_row;
+        double z = z_row, u = u_row, v = v_row;
+        bool entered = false;
+
+        for (int x = s.xmin; x <= s.xmax; x++) {
+            if (w0 + off.reach[0] >= 0 && w1 + off.reach[1] >= 0 && w2 + off.reach[2] >= 0) {
+                entered = true;
+                float *zp = st.depth(x, y);
+                const __m128d w0v = _mm_set1_pd(w0), w1v = _mm_set1_pd(w1), w2v = _mm_set1_pd(w2);
+                const __m128d zv = _mm_set1_pd(z);
+                __m128 pz[N / 4];
+                int cover = 0;
+                for (int g = 0; g < groups; g++) {
+                    __m128d in = _mm_cmpge_pd(_mm_add_pd(w0v, ow[0][g]), zero);
+                    in = _mm_and_pd(in, _mm_cmpge_pd(_mm_add_pd(w1v, ow[1][g]), zero));
+                    in = _mm_and_pd(in, _mm_cmpge_pd(_mm_add_pd(w2v, ow[2][g]), zero));
+                    cover |= _mm_movemask_pd(in) << 2 * g;
+                    const __m128 z2 = _mm_cvtpd_ps(_mm_round_pd(_mm_add_pd(zv, oz[g]), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC));
+                    pz[g / 2] = g % 2 ? _mm_movelh_ps(pz[g / 2], z2) : z2;
+                }
+                if (cover) {
+                    // 4 samples per float vector
+                    int pass = 0;
+                    for (int q = 0; q < N / 4; q++) {
+                        pass |= _mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps(zp + 4 * q), pz[q])) << 4 * q;
+                    }
+                    pass &= cover;
+                    if (pass) {
+                        const __m128i c = _mm_set1_epi32(shader.fragment(bound, x, y, u, v));
+                        std::uint32_t *cp = st.color(x, y);
+                        for (int q = 0; q < N / 4; q++) {
+                            const __m128i m = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(pass >> 4 * q), bits), bits);
+                            float *zq = zp + 4 * q;
+                            __m128i *cq = reinterpret_cast<__m128i *>(cp + 4 * q);
+                            _mm_storeu_ps(zq, _mm_blendv_ps(_mm_loadu_ps(zq), pz[q], _mm_castsi128_ps(m)));
+                            _mm_storeu_si128(cq, _mm_blendv_epi8(_mm_loadu_si128(cq), c, m));
+                        }
+                    }
+                }
+            } else if (entered) {
+                break;
+            }
+
+            w0 += t.w[0].a;
+            w1 += t.w[1].a;
+            w2 += t.w[2].a;
+            z += t.z.a;
+            if constexpr (S::uses_uv) {
+                u += t.u.a;
+                v += t.v.a;
+            }
+        }
+
+        w0_row += t.w[0].b;
+        w1_row += t.w[1].b;
+        w2_row += t.w[2].b;
+        z_row += t.z.b;
+        if constexpr (S::uses_uv) {
+            u_row += t.u.b;
+            v_row += t.v.b;
+        }
+    }
+}
+
+template <typename S>
+bool raster_avx2(const S &shader, const typename S::Face &face, const TriangleSetup &t, DepthBuffer &zb,
+                 TGAImage &image, const Tile &clip)
+{
+    switch (zb.format()) {
+        case DepthBuffer::FLOAT32: return kernel_avx2<S, DepthBuffer::FLOAT32>(shader, face, t, zb, image, clip);
+        case DepthBuffer::UNORM24: return kernel_avx2<S, DepthBuffer::UNORM24>(shader, face, t, zb, image, clip);
+        default: return kernel_avx2<S, DepthBuffer::UNORM16>(shader, face, t, zb, image, clip);
+    }
+}
+
+template <typename S>
+bool raster_sse41(const S &shader, const typename S::Face &face, const TriangleSetup &t, DepthBuffer &zb,
+                  TGAImage &image, const Tile &clip)
+{
+    switch (zb.format()) {
+        case DepthBuffer::FLOAT32: return kernel_sse41<S, DepthBuffer::FLOAT32>(shader, face, t, zb, image, clip);
+        case DepthBuffer::UNORM24: return kernel_sse41<S, DepthBuffer::UNORM24>(shader, face, t, zb, image, clip);
+        default: return kernel_sse41<S, DepthBuffer::UNORM16>(shader, face, t, zb, image, clip);
+    }
+}
+
+bool depth_avx2(const TriangleSetup &t, DepthBuffer &zb, const Tile &clip)
+{
+    switch (zb.format()) {
+        case DepthBuffer::FLOAT32: return depth_kernel_avx2<DepthBuffer::FLOAT32>(t, zb, clip);
+        case DepthBuffer::UNORM24: return depth_kernel_avx2<DepthBuffer::UNORM24>(t, zb, clip);
+        default: return depth_kernel_avx2<DepthBuffer::UNORM16>(t, zb, clip);
+    }
+}
+
+bool depth_sse41(const TriangleSetup &t, DepthBuffer &zb, const Tile &clip)
+{
+    switch (zb.format()) {
+        case DepthBuffer::FLOAT32: return depth_kernel_sse41<DepthBuffer::FLOAT32>(t, zb, clip);
+        case DepthBuffer::UNORM24: return depth_kernel_sse41<DepthBuffer::UNORM24>(t, zb, clip);
+        default: return depth_kernel_sse41<DepthBuffer::UNORM16>(t, zb, clip);
+    }
+}
+
+template <typename S>
+void raster_msaa_avx2(const S &shader, const typename S::Face &face, const TriangleSetup &t, SampleTile &st,
+                      const Tile &clip)
+{
+    if (st.samples() == 8) msaa_kernel_avx2<S, 8>(shader, face, t, st, clip);
+    else msaa_kernel_avx2<S, 4>(shader, face, t, st, clip);
+}
+
+template <typename S>
+void raster_msaa_sse41(const S &shader, const typename S::Face &face, const TriangleSetup &t, SampleTile &st,
+                       const Tile &clip)
+{
+    if (st.samples() == 8) msaa_kernel_sse41<S, 8>(shader, face, t, st, clip);
+    else msaa_kernel_sse41<S, 4>(shader, face, t, st, clip);
+}
+
+// Every shader the renderer draws with gets its kernels here
+#define INSTANTIATE_KERNELS(S)                                                                                  \
+    template bool raster_avx2<S>(const S &, const S::Face &, const TriangleSetup &, DepthBuffer &, TGAImage &,  \
+                                 const Tile &);                                                                \
+    template bool raster_sse41<S>(const S &, const S::Face &, const TriangleSetup &, DepthBuffer &, TGAImage &, \
+                                  const Tile &);                                                               \
+    template void raster_msaa_avx2<S>(const S &, const S::Face &, const TriangleSetup &, SampleTile &,          \
+                                      const Tile &);                                                           \
+    template void raster_msaa_sse41<S>(const S &, const S::Face &, const TriangleSetup &, SampleTile &,         \
+                                       const Tile &);
+
+INSTANTIATE_KERNELS(FlatShader)
+INSTANTIATE_KERNELS(DiffuseShader)
+INSTANTIATE_KERNELS(ShadowedShader)
+INSTANTIATE_KERNELS(ObjectShader<TintedShader<DiffuseShader>>)
+
+#endif
@@ -0,0 +1,66 @@
+#pragma once
+
+/*
+	Pixel block kernels for draw_triangle(), draw_depth() and draw_triangle_msaa()
+
+	--> AVX2 handles a block of 8 pixels of a row per step, SSE4.1 a block of 4
+	--> each step does the coverage test, z and uv interpolation, the z-test and the masked depth/color
+		write for the whole block, only the shader's fragment stage runs per surviving pixel
+	--> like the scalar kernel they are templates on the shader (see shader.h), defined in raster_simd.cpp and
+		instantiated there for every shader
+	--> blocks are aligned to multiples of their width, so all pixels of a block lie in the same 64x64 tile and
+		the whole block can be loaded, blended and stored back without touching anybody else's pixels
+	--> every depth format has its own load/store, the z-test itself runs on encoded depths as doubles
+	--> like the scalar kernels they return whether any depth was written
+	--> the kernel is picked once at runtime from what the cpu supports, the scalar kernels in triangle.h
+		are the fallback (and what non x86 builds always use)
+	--> the multisample kernels go one pixel at a time instead, with its samples as the vector (4 per step for
+		AVX2, 2 for SSE4.1)
+	--> the RASTER_KERNEL environment variable (scalar, sse41 or avx2) overrides the choice, handy for
+		comparing kernels against each other
+*/
+
+#if defined(__x86_64__) || defined(__i386__)
+#define RASTER_SIMD 1
+#else
+#define RASTER_SIMD 0
+#endif
+
+class TGAImage;
+class Model;
+class DepthBuffer;
+struct Tile;
+struct TriangleSetup;
+class SampleTile;
+
+enum class RasterKernel
+{
+    Scalar,
+    SSE41,
+    AVX2
+};
+
+RasterKernel raster_kernel();
+void set_raster_kernel(const RasterKernel k);
+const char *raster_kernel_name(const RasterKernel k);
+
+#if RASTER_SIMD
+template <typename S>
+bool raster_avx2(const S &shader, const typename S::Face &face, const TriangleSetup &t, DepthBuffer &zb,
+                 TGAImage &image, const Tile &clip);
+template <typename S>
+bool raster_sse41(const S &shader, const typename S::Face &face, const TriangleSetup &t, DepthBuffer &zb,
+                  TGAImage &image, const Tile &clip);
+
+// depth only, for shadow maps
+bool depth_avx2(const TriangleSetup &t, DepthBuffer &zb, const Tile &clip);
+bool depth_sse41(const TriangleSetup &t, DepthBuffer &zb, const Tile &clip);
+
+// multisampled, into the samples of a tile (see msaa.h)
+template <typename S>
+void raster_msaa_avx2(const S &shader, const typename S::Face &face, const TriangleSetup &t, SampleTile &st,
+                      const Tile &clip);
+template <typename S>
+void raster_msaa_sse41(const S &shader, const typename S::Face &face, const TriangleSetup &t, SampleTile &st,
+                       const Tile &clip);
+#endif
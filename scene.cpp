@@ -0,0 +1,88 @@
+#include "scene.h"
+#include <algorithm>
+
+void Scene::add(const Instance &object)
+{
+    // world bbox of the 8 corners of the model's bbox
+    const vec3f &mlo = object.mesh->bbox_min(), &mhi = object.mesh->bbox_max();
+    vec3f lo(1e30, 1e30, 1e30), hi(-1e30, -1e30, -1e30);
+    for (int i = 0; i < 8; i++) {
+        const vec3f corner(i & 1 ? mhi.x : mlo.x, i & 2 ? mhi.y : mlo.y, i & 4 ? mhi.z : mlo.z);
+        const vec3f w = proj<3>(object.model * embed<4>(corner));
+        lo = vec3f(std::min(lo.x, w.x), std::min(lo.y, w.y), std::min(lo.z, w.z));
+        hi = vec3f(std::max(hi.x, w.x), std::max(hi.y, w.y), std::max(hi.z, w.z));
+    }
+    objects_.push_back(object);
+    lo_.push_back(lo);
+    hi_.push_back(hi);
+}
+
+void Scene::build()
+{
+    order_.resize(objects_.size());
+    for (std::uint32_t i = 0; i < order_.size(); i++) order_[i] = i;
+    nodes_.clear();
+    if (!objects_.empty()) build(0, static_cast<std::uint32_t>(order_.size()));
+}
+
+void Scene::build(const std::uint32_t begin, const std::uint32_t end)
+{
+    const std::uint32_t index = static_cast<std::uint32_t>(nodes_.size());
+    nodes_.push_back(Node{vec3f(1e30, 1e30, 1e30), vec3f(-1e30, -1e30, -1e30), begin, end, 0});
+
+    vec3f lo = nodes_[index].lo, hi = nodes_[index].hi, clo = lo, chi = hi;
+    for (std::uint32_t i = begin; i < end; i++) {
+        const vec3f &l = lo_[order_[i]], &h = hi_[order_[i]];
+        const vec3f c = (l + h) * 0.5;
+        lo = vec3f(std::min(lo.x, l.x), std::min(lo.y, l.y), std::min(lo.z, l.z));
+        hi = vec3f(std::max(hi.x, h.x), std::max(hi.y, h.y), std::max(hi.z, h.z));
+        clo = vec3f(std::min(clo.x, c.x), std::min(clo.y, c.y), std::min(clo.z, c.z));
+        chi = vec3f(std::max(chi.x, c.x), std::max(chi.y, c.y), std::max(chi.z, c.z));
+    }
+    nodes_[index].lo = lo;
+    nodes_[index].hi = hi;
+    if (end - begin <= leaf_size) return;
+
+    // median split along the longest axis of the centers, the halves differ by one object at most
+    const vec3f extent = chi - clo;
+    const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+    const std::uint32_t mid = begin + (end - begin) / 2;
+    std::nth_element(order_.begin() + begin, order_.begin() + mid, order_.begin() + end,
+                     [&](const std::uint32_t a, const std::uint32_t b) {
+                         return lo_[a][axis] + hi_[a][axis] < lo_[b][axis] + hi_[b][axis];
+                     });
+
+    build(begin, mid);
+    nodes_[index].second = static_cast<std::uint32_t>(nodes_.size());
+    build(mid, end);
+}
+
+void Scene::cull(const mat4 &vp, const ClipParams &params, std::vector<std::uint32_t> &visible) const
+{
+    visible.clear();
+    if (nodes_.empty()) return;
+
+    // median splits keep the depth around log2(objects / leaf_size), far below the stack's size
+    std::uint32_t stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top) {
+        const Node &node = nodes_[stack[--top]];
+        unsigned any_out;
+        if (box_outcode(node.lo, node.hi, vp, params, any_out) & CLIP_FRUSTUM) continue;
+
+        if (!(any_out & CLIP_FRUSTUM)) {
+            visible.insert(visible.end(), order_.begin() + node.begin, order_.begin() + node.end);
+        } else if (node.second) {
+            const std::uint32_t first = static_cast<std::uint32_t>(&node - nodes_.data()) + 1;
+            stack[top++] = node.second;
+            stack[top++] = first;
+        } else {
+            for (std::uint32_t i = node.begin; i < node.end; i++) {
+                const Instance &object = objects_[order_[i]];
+                if (bbox_visible(*object.mesh, vp * object.model, params)) visible.push_back(order_[i]);
+            }
+        }
+    }
+    std::sort(visible.begin(), visible.end());
+}
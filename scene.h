@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "clip.h"
+#include "geometry.h"
+#include "instance.h"
+
+/*
+	Scene : every object of a frame (instances of one or several models) with its world space bbox, in a BVH
+
+	--> an object's world bbox bounds the 8 corners of its model's bbox through its model matrix. The BVH is built
+		top down over those, each node split at the median object along the longest axis of its objects' centers,
+		down to leaves of a few objects. Nodes sit in one array, a node's first child right after it
+	--> cull() walks it with the camera's projection*view before any vertex work : a node outside one frustum
+		plane is skipped with everything below it, a node completely inside takes all its objects without another
+		test, only the leaves the frustum cuts through test their objects one by one (against the tighter bbox in
+		the model's space). A frame costs about the visible objects plus the nodes along the frustum's boundary,
+		not the whole scene
+	--> the visible objects come back in the order they were added in, so the frame draws them like it would a
+		plain list
+	--> objects don't move once added, build() must run again after add()
+*/
+class Scene
+{
+private:
+    struct Node
+    {
+        vec3f lo, hi;
+        std::uint32_t begin, end;  // objects of the subtree, order_[begin, end)
+        std::uint32_t second;      // index of the second child, 0 for a leaf
+    };
+
+    std::vector<Instance> objects_;
+    std::vector<vec3f> lo_, hi_;        // world bbox of every object
+    std::vector<std::uint32_t> order_;  // object ids, the ones of a leaf are next to each other
+    std::vector<Node> nodes_;
+
+    void build(const std::uint32_t begin, const std::uint32_t end);
+
+public:
+    static constexpr std::uint32_t leaf_size = 4;
+
+    void add(const Instance &object);
+    void build();
+
+    size_t size() const { return objects_.size(); }
+    const Instance &object(const size_t id) const { return objects_[id]; }
+
+    // ids of the objects that may be visible through vp (projection*view), ascending
+    void cull(const mat4 &vp, const ClipParams &params, std::vector<std::uint32_t> &visible) const;
+};
@@ -0,0 +1,196 @@
+#pragma once
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include "geometry.h"
+#include "model.h"
+#include "tgaimage.h"
+#include "trianglesetup.h"
+
+/*
+	Shaders : what the pipeline runs per face and per pixel, as a compile time interface
+
+	--> vertex(face, out) runs once per face, after the vertex stage has put its corners on the screen. It returns
+		false to cull the face, otherwise it fills S::Face with whatever is constant over the face (flat lighting)
+	--> bind(setup, face) runs once per raster call of a triangle and returns S::Bound, the per triangle state of
+		the fragment stage (e.g. the texture sampler picked from the triangle's uv gradients)
+	--> fragment(bound, x, y, u, v) is the bgra color of pixel (x, y) once it passed the depth test
+	--> uses_uv tells the pipeline to set up and step the uv planes, shaders that don't read them skip that work
+	--> the raster kernels are templates on the shader, so each shader gets its own pixel loop with its fragment
+		stage inlined and nothing is decided per pixel at runtime. The SIMD kernels live in raster_simd.cpp and are
+		instantiated there for every shader listed at its end, a new shader adds itself to that list
+*/
+template <typename S>
+concept Shader = requires(const S &shader, const size_t face, typename S::Face &out, const typename S::Face &in,
+                          const TriangleSetup &setup, const typename S::Bound &bound, const int x, const int y,
+                          const double u, const double v) {
+    { S::uses_uv } -> std::convertible_to<bool>;
+    { shader.vertex(face, out) } -> std::same_as<bool>;
+    { shader.bind(setup, in) } -> std::same_as<typename S::Bound>;
+    { shader.fragment(bound, x, y, u, v) } -> std::same_as<std::uint32_t>;
+};
+
+// Face after vertex() and triangle setup, ready to be binned and rasterized
+template <Shader S>
+struct ShadedTriangle
+{
+    TriangleSetup setup;
+    [[no_unique_address]] typename S::Face face;
+};
+
+// Lambert term of a face from its normal, light_dir in the same (model) space
+inline double face_lambert(const Model &model, const size_t face, const vec3f &light_dir)
+{
+    return dot(model.face_normal(face), light_dir);
+}
+
+// One gray per face, scaled by its lambert term, faces turned away from the light are culled
+struct FlatShader
+{
+    static constexpr bool uses_uv = false;
+    struct Face
+    {
+        TGAColor color;
+    };
+    using Bound = std::uint32_t;
+
+    const Model *model = nullptr;
+    vec3f light_dir;
+
+    bool vertex(const size_t face, Face &out) const
+    {
+        const double intensity = face_lambert(*model, face, light_dir);
+        if (intensity <= 0) return false;
+        const auto gray = static_cast<std::uint8_t>(intensity * 255);
+        out.color = TGAColor(gray, gray, gray);
+        return true;
+    }
+
+    Bound bind(const TriangleSetup &, const Face &face) const
+    {
+        std::uint32_t bgra;
+        std::memcpy(&bgra, face.color.bgra, 4);
+        return bgra;
+    }
+
+    std::uint32_t fragment(const Bound &bgra, int, int, double, double) const { return bgra; }
+};
+
+// The model's diffuse texture, unlit, faces turned away from the light are culled
+struct DiffuseShader
+{
+    static constexpr bool uses_uv = true;
+    struct Face
+    {};
+    using Bound = Texture::Sampler;
+
+    const Model *model = nullptr;
+    vec3f light_dir;
+
+    bool vertex(const size_t face, Face &) const { return face_lambert(*model, face, light_dir) > 0; }
+
+    // the uv plane gradients give the triangle's texel footprint for mip selection
+    Bound bind(const TriangleSetup &t, const Face &) const
+    {
+        return model->diffuse_map().sampler(t.u.a, t.v.a, t.u.b, t.v.b);
+    }
+
+    std::uint32_t fragment(const Bound &tex, int, int, const double u, const double v) const
+    {
+        return tex.sample_bgra(u, v);
+    }
+};
+
+/*
+	Shader S with a color multiplier per face, how instances of one model are told apart (see instance.h)
+
+	--> the tint is part of Face, so triangles of differently tinted instances can share a frame's triangle list
+		and its tiles. vertex() stamps the shader's tint on the faces it sets up, bind() and fragment() only read
+		it back, so any copy of the shader can draw triangles set up by another
+	--> each channel is scaled by about tint/255, in fixed point as (tint + (tint >> 7))/256 : a tint of 128 and
+		up gets one more 256th, so 255 becomes 256/256 and leaves a channel untouched, 0 clears it, and the rest
+		stays within half a 256th of tint/255
+*/
+template <Shader S>
+struct TintedShader
+{
+    static constexpr bool uses_uv = S::uses_uv;
+    struct Face
+    {
+        [[no_unique_address]] typename S::Face base;
+        std::uint32_t tint;  // bgra
+    };
+    struct Bound
+    {
+        typename S::Bound base;
+        std::uint32_t scale[3];  // of b, g and r in 1/256
+    };
+
+    S base;
+    TGAColor tint = TGAColor(255, 255, 255);
+
+    bool vertex(const size_t face, Face &out) const
+    {
+        std::memcpy(&out.tint, tint.bgra, 4);
+        return base.vertex(face, out.base);
+    }
+
+    Bound bind(const TriangleSetup &t, const Face &face) const
+    {
+        Bound b{base.bind(t, face.base), {}};
+        for (int k = 0; k < 3; k++) {
+            const std::uint32_t c = face.tint >> 8 * k & 0xff;
+            b.scale[k] = c + (c >> 7);
+        }
+        return b;
+    }
+
+    std::uint32_t fragment(const Bound &b, const int x, const int y, const double u, const double v) const
+    {
+        const std::uint32_t c = base.fragment(b.base, x, y, u, v);
+        std::uint32_t out = c & 0xff000000u;
+        for (int k = 0; k < 3; k++) out |= ((c >> 8 * k & 0xff) * b.scale[k] >> 8) << 8 * k;
+        return out;
+    }
+};
+
+/*
+	Shader S whose faces remember the shader that set them up, so objects with shaders of their own (another
+	model, texture, light or tint) share a frame's triangle list and its tiles (see scene.h)
+
+	--> vertex() is the object's, bind() and fragment() go through the pointer the face and its bound carry.
+		The shaders pointed at must outlive the raster pass, any copy of ObjectShader draws the faces
+*/
+template <Shader S>
+struct ObjectShader
+{
+    static constexpr bool uses_uv = S::uses_uv;
+    struct Face
+    {
+        typename S::Face base;
+        const S *object;
+    };
+    struct Bound
+    {
+        typename S::Bound base;
+        const S *object;
+    };
+
+    const S *object = nullptr;
+
+    bool vertex(const size_t face, Face &out) const
+    {
+        out.object = object;
+        return object->vertex(face, out.base);
+    }
+
+    Bound bind(const TriangleSetup &t, const Face &face) const
+    {
+        return Bound{face.object->bind(t, face.base), face.object};
+    }
+
+    std::uint32_t fragment(const Bound &b, const int x, const int y, const double u, const double v) const
+    {
+        return b.object->fragment(b.base, x, y, u, v);
+    }
+};
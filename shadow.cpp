@@ -0,0 +1,98 @@
+#include "shadow.h"
+#include <algorithm>
+#include <cmath>
+#include "transform.h"
+#include "triangle.h"
+
+ShadowMap::ShadowMap(const int size)
+    : size_(size), depth_(size, size, DepthBuffer::FLOAT32, 0, depth_range), binner_(size, size)
+{}
+
+void ShadowMap::setup(const Model &model, const vec3f &light_dir, ThreadPool &pool)
+{
+    // bounding sphere around the center of the model's bbox
+    const vec3f center = (model.bbox_min() + model.bbox_max()) * 0.5;
+    double radius = 0;
+    for (size_t i = 0; i < model.nverts(); i++) radius = std::max(radius, (model.vert(i) - center).norm());
+    radius = std::max(radius, 1e-6);
+
+    // the light sits 2 radii back along its direction, view z of the model is then in [-3r, -r]
+    vec3f dir = light_dir;
+    dir.normalize();
+    const vec3f up = std::abs(dir.y) > 0.99 ? vec3f(1, 0, 0) : vec3f(0, 1, 0);
+    const mat4 view = lookat(center - dir * (2 * radius), center, up);
+
+    // orthographic : x and y in [-r, r] and z in [-3r, -r] to [-1, 1], closer to the light is bigger
+    mat4 ortho = mat4::identity();
+    ortho[0][0] = ortho[1][1] = ortho[2][2] = 1 / radius;
+    ortho[2][3] = 2;
+    world_to_map_ = viewport(0, 0, size_, size_, depth_range) * ortho * view;
+
+    light_dir_ = dir;
+
+    VertexStage vs;
+    vs.mvp = world_to_map_;
+    vs.perspective_divide = false;
+    run_vertex_stage(vs, model, screen_, pool);
+
+    tris_.clear();
+    tris_.reserve(model.nfaces());
+    binner_.clear();
+    for (size_t i = 0; i < model.nfaces(); i++) {
+        const vec3f pts[3] = {screen_[model.vert_index(i, 0)], screen_[model.vert_index(i, 1)],
+                              screen_[model.vert_index(i, 2)]};
+        TriangleSetup t;
+        if (!t.init(pts, nullptr, size_, size_)) continue;
+        binner_.bin(tris_.size(), t.xmin, t.ymin, t.xmax, t.ymax);
+        tris_.push_back(t);
+    }
+}
+
+void ShadowMap::raster(ThreadPool &pool, TGAImage *color)
+{
+    pool.parallel_for(binner_.ntiles(), [&](size_t t) {
+        const Tile tile = binner_.tile(t);
+        depth_.clear(tile.x0, tile.y0, tile.x1 + 1, tile.y1 + 1);
+        if (color) {
+            const FlatShader::Face face{TGAColor(255, 255, 255)};
+            for (uint32_t id : binner_.tris(t)) draw_triangle(FlatShader{}, face, tris_[id], depth_, *color, tile);
+        } else {
+            for (uint32_t id : binner_.tris(t)) draw_depth(tris_[id], depth_, tile);
+        }
+    });
+}
+
+void ShadowMap::render(const Model &model, const vec3f &light_dir, ThreadPool &pool)
+{
+    setup(model, light_dir, pool);
+    raster(pool);
+}
+
+double ShadowMap::face_bias(const Model &model, const size_t face) const
+{
+    if (face_lambert(model, face, light_dir_) <= 0) return -1;
+
+    // the face's plane in the map, z = z0 + dzdx*x + dzdy*y
+    vec3f p[3];
+    for (int i = 0; i < 3; i++) {
+        const vec4f m = world_to_map_ * embed<4>(model.vert(face, i));
+        p[i] = vec3f(m[0], m[1], m[2]);
+    }
+    const vec3f n = cross(p[1] - p[0], p[2] - p[0]);
+    const double texel_depth = static_cast<double>(depth_range) / size_;  // depth of a 45 degree face over a texel
+    const double limit = max_slope * texel_depth;
+    const double slope = std::abs(n.z) * limit > std::abs(n.x) + std::abs(n.y)
+                             ? (std::abs(n.x) + std::abs(n.y)) / std::abs(n.z)
+                             : limit;
+
+    // half a texel of slope both ways, doubled for the map's own rounding, and the truncated stored depths
+    return slope + 1;
+}
+
+mat4 screen_to_shadow_map(const VertexStage &vs, const ShadowMap &map)
+{
+    // undo flip_z, then viewport*mvp back to homogeneous world coordinates and on into the map
+    mat4 flip = mat4::identity();
+    if (vs.flip_z) flip[2][2] = -1;
+    return map.world_to_map() * (vs.viewport * vs.mvp).invert() * flip;
+}
@@ -0,0 +1,134 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "geometry.h"
+#include "model.h"
+#include "depthbuffer.h"
+#include "tiles.h"
+#include "threadpool.h"
+#include "trianglesetup.h"
+#include "shader.h"
+#include "vertex.h"
+
+class TGAImage;
+
+/*
+	Shadow map of a directional light
+
+	--> rendered from the light with an orthographic projection fitted around the model's bounding sphere, through
+		the depth only kernels (draw_depth()) : no uv, no color, nothing but the depth test
+	--> depth follows the main pass convention (bigger is closer to the light) but over [0, depth_range], the
+		kernels store truncated depths and this keeps those steps far below the size of a texel
+	--> nothing is culled, faces turned away from the light still cast shadows (and are what stops light leaking
+		through the silhouette)
+	--> a lookup is off by up to half a texel, over which a face tilted away from the light changes its depth by
+		its slope in the map. Each face gets that much bias (slope scaled, computed once per face), capped so
+		grazing faces don't push their shadows through thin geometry
+	--> setup() places the light and bins the triangles, raster() clears and draws the map. Both run on the thread
+		pool over tiles like the main pass. While model and light don't move one render() serves every frame
+*/
+class ShadowMap
+{
+private:
+    int size_;
+    DepthBuffer depth_;
+    TileBinner binner_;
+    std::vector<vec3f> screen_;
+    std::vector<TriangleSetup> tris_;
+    mat4 world_to_map_ = mat4::identity();
+    vec3f light_dir_;
+
+public:
+    static constexpr int depth_range = 65535;
+    static constexpr double max_slope = 16;  // steepest depth slope, in depth per texel of a flat face, given a bias
+
+    explicit ShadowMap(const int size = 2048);
+
+    // light_dir is the way the light travels, like render()'s
+    void setup(const Model &model, const vec3f &light_dir, ThreadPool &pool);
+    // color given : draws through the flat color kernels too, only to compare the depth only path against them
+    void raster(ThreadPool &pool, TGAImage *color = nullptr);
+    void render(const Model &model, const vec3f &light_dir, ThreadPool &pool);
+
+    int size() const { return size_; }
+    size_t ntriangles() const { return tris_.size(); }
+    const DepthBuffer &depth() const { return depth_; }
+    // world position to (x, y) on the map and depth
+    const mat4 &world_to_map() const { return world_to_map_; }
+
+    // depth bias of a face's lookups, negative when the face is turned away from the light (always in shadow)
+    double face_bias(const Model &model, const size_t face) const;
+
+    // false when point (x, y, z) of the map lies behind what the light hits there, outside the map is lit.
+    // pixels are sampled at integer coordinates, so (x, y) looks up the nearest one
+    bool lit(const double x, const double y, const double z, const double bias) const
+    {
+        if (bias < 0) return false;
+        const double px = x + 0.5, py = y + 0.5;
+        if (!(px >= 0 && py >= 0 && px < size_ && py < size_)) return true;
+        const float stored = depth_.data<float>()[static_cast<int>(px) + static_cast<int>(py) * size_];
+        return z + bias >= stored;
+    }
+};
+
+// Screen (x, y, z, 1) of a pixel drawn with vertex stage vs to homogeneous shadow map coordinates
+mat4 screen_to_shadow_map(const VertexStage &vs, const ShadowMap &map);
+
+/*
+	DiffuseShader whose pixels are darkened where the shadow map says the light doesn't reach them
+
+	--> a pixel's screen z is a plane over the triangle and screen_to_map is linear in (x, y, z, 1), so each
+		homogeneous shadow map coordinate is a plane too. bind() builds the four of them, the fragment stage
+		evaluates them and divides, which is exact (perspective correct) for every pixel, clipped triangles
+		included
+*/
+struct ShadowedShader
+{
+    static constexpr bool uses_uv = true;
+    struct Face
+    {
+        double bias;  // ShadowMap::face_bias()
+    };
+    struct Bound
+    {
+        DiffuseShader::Bound diffuse;
+        Plane map[4];
+        double bias;
+    };
+
+    DiffuseShader diffuse;
+    const ShadowMap *shadow = nullptr;
+    mat4 screen_to_map;  // screen_to_shadow_map() of the pass
+
+    static constexpr std::uint32_t ambient = 110;  // what is left of a shadowed color, in 1/256
+
+    bool vertex(const size_t face, Face &out) const
+    {
+        DiffuseShader::Face unused;
+        if (!diffuse.vertex(face, unused)) return false;
+        out.bias = shadow->face_bias(*diffuse.model, face);
+        return true;
+    }
+
+    Bound bind(const TriangleSetup &t, const Face &face) const
+    {
+        Bound b{diffuse.bind(t, {}), {}, face.bias};
+        for (int k = 0; k < 4; k++) {
+            const double m0 = screen_to_map[k][0], m1 = screen_to_map[k][1];
+            const double m2 = screen_to_map[k][2], m3 = screen_to_map[k][3];
+            b.map[k] = Plane{m0 + m2 * t.z.a, m1 + m2 * t.z.b, m3 + m2 * t.z.c};
+        }
+        return b;
+    }
+
+    std::uint32_t fragment(const Bound &b, const int x, const int y, const double u, const double v) const
+    {
+        const std::uint32_t c = diffuse.fragment(b.diffuse, x, y, u, v);
+        const double w = b.map[3].at(x, y);
+        if (shadow->lit(b.map[0].at(x, y) / w, b.map[1].at(x, y) / w, b.map[2].at(x, y) / w, b.bias)) return c;
+        // scale b, g and r at once, every product stays inside its own 16 bits
+        const std::uint32_t rb = ((c & 0x00ff00ffu) * ambient >> 8) & 0x00ff00ffu;
+        const std::uint32_t g = ((c & 0x0000ff00u) * ambient >> 8) & 0x0000ff00u;
+        return (c & 0xff000000u) | rb | g;
+    }
+};
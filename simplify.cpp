@@ -0,0 +1,319 @@
+#include "simplify.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <queue>
+#include <utility>
+
+namespace {
+
+// symmetric 4x4 matrix of a sum of squared plane distances : xx xy xz xw yy yz yw zz zw ww
+struct Quadric
+{
+    double a[10] = {};
+
+    void add_plane(const vec3f &n, const double d)
+    {
+        a[0] += n.x * n.x, a[1] += n.x * n.y, a[2] += n.x * n.z, a[3] += n.x * d;
+        a[4] += n.y * n.y, a[5] += n.y * n.z, a[6] += n.y * d;
+        a[7] += n.z * n.z, a[8] += n.z * d;
+        a[9] += d * d;
+    }
+
+    Quadric &operator+=(const Quadric &q)
+    {
+        for (int i = 0; i < 10; i++) a[i] += q.a[i];
+        return *this;
+    }
+
+    double error(const vec3f &p) const
+    {
+        const double x = p.x, y = p.y, z = p.z;
+        return a[0] * x * x + a[4] * y * y + a[7] * z * z + a[9] +
+               2 * (a[1] * x * y + a[2] * x * z + a[3] * x + a[5] * y * z + a[6] * y + a[8] * z);
+    }
+};
+
+struct Collapse
+{
+    double cost;
+    std::uint32_t from, to;  // from goes onto to
+    std::uint32_t stamp;     // of from when it was queued
+
+    // cheaper first, ties by the target so a vertex's candidates have one order
+    bool before(const double c, const std::uint32_t t) const { return cost != c ? cost < c : to < t; }
+    bool operator>(const Collapse &c) const { return c.before(cost, to) || (cost == c.cost && to == c.to && from > c.from); }
+};
+
+class Simplifier
+{
+private:
+    const MeshView &src_;
+    std::vector<int> vrt_, tex_, nrm_;  // 3 per face, a copy of the source's that collapses rewrite
+    std::vector<char> face_alive_, vert_alive_;
+    std::vector<std::vector<std::uint32_t>> vert_faces_;  // faces around a vertex, dead ones are skipped
+    std::vector<Quadric> quadrics_;
+    std::vector<std::uint32_t> stamps_;
+    std::vector<Collapse> queued_;  // the entry of every vertex that isn't stale, to is UINT32_MAX when it has none
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap_;
+    size_t nfaces_ = 0;
+    double error_ = 0;
+    std::vector<std::uint32_t> faces_a_, faces_b_, ring_a_, ring_b_;  // try_collapse()'s, kept between calls
+    std::vector<std::uint32_t> faces_v_, ring_v_;                     // queue()'s
+    std::vector<std::pair<int, std::pair<int, int>>> remap_;          // tex coord of b to tex coord and normal of a
+
+    const vec3f &pos(const std::uint32_t v) const { return src_.verts[v]; }
+
+    int corner(const std::uint32_t f, const std::uint32_t v) const
+    {
+        for (int k = 0; k < 3; k++)
+            if (vrt_[f * 3 + k] == static_cast<int>(v)) return k;
+        return -1;
+    }
+
+    // alive faces around v, and the vertices they connect v to
+    void ring(const std::uint32_t v, std::vector<std::uint32_t> &faces, std::vector<std::uint32_t> *neighbours) const
+    {
+        faces.clear();
+        for (std::uint32_t f : vert_faces_[v])
+            if (face_alive_[f]) faces.push_back(f);
+        if (!neighbours) return;
+        neighbours->clear();
+        for (std::uint32_t f : faces)
+            for (int k = 0; k < 3; k++)
+                if (vrt_[f * 3 + k] != static_cast<int>(v)) neighbours->push_back(vrt_[f * 3 + k]);
+        std::sort(neighbours->begin(), neighbours->end());
+        neighbours->erase(std::unique(neighbours->begin(), neighbours->end()), neighbours->end());
+    }
+
+    double cost(const std::uint32_t from, const std::uint32_t to) const
+    {
+        Quadric q = quadrics_[from];
+        q += quadrics_[to];
+        return std::max(q.error(pos(to)), 0.0);
+    }
+
+    // queues c as from's collapse, whatever from had queued before goes stale
+    void queue(const Collapse &c)
+    {
+        stamps_[c.from]++;
+        queued_[c.from] = c;
+        queued_[c.from].stamp = stamps_[c.from];
+        if (c.to != UINT32_MAX) heap_.push(queued_[c.from]);
+    }
+
+    // queues the cheapest collapse of v, or the cheapest one after `after` when that one was refused
+    void queue_best(const std::uint32_t v, const Collapse *after = nullptr)
+    {
+        ring(v, faces_v_, &ring_v_);
+        Collapse best{0, v, UINT32_MAX, 0};
+        for (std::uint32_t to : ring_v_) {
+            const double c = cost(v, to);
+            if (after && !after->before(c, to)) continue;
+            if (best.to == UINT32_MAX || !best.before(c, to)) best.cost = c, best.to = to;
+        }
+        queue(best);
+    }
+
+    bool try_collapse(const Collapse &c);
+
+public:
+    explicit Simplifier(const MeshView &src);
+
+    size_t nfaces() const { return nfaces_; }
+    double error() const { return error_; }
+
+    // collapses until at most target faces are left, false when it ran out of collapses first
+    bool run(const size_t target);
+    ObjMesh compact() const;
+};
+
+Simplifier::Simplifier(const MeshView &src)
+    : src_(src), vrt_(src.facet_vrt.begin(), src.facet_vrt.end()), tex_(src.facet_tex.begin(), src.facet_tex.end()),
+      nrm_(src.facet_nrm.begin(), src.facet_nrm.end()), face_alive_(vrt_.size() / 3, 1),
+      vert_alive_(src.verts.size(), 1), vert_faces_(src.verts.size()), quadrics_(src.verts.size()),
+      stamps_(src.verts.size(), 0), queued_(src.verts.size()), nfaces_(vrt_.size() / 3)
+{
+    // every edge once per face, (low, high, face), the ones found only once are on a boundary and get a plane
+    std::vector<std::pair<std::pair<std::uint32_t, std::uint32_t>, std::uint32_t>> edges;
+    edges.reserve(vrt_.size());
+    for (std::uint32_t f = 0; f < nfaces_; f++) {
+        const vec3f &p0 = pos(vrt_[f * 3]), &p1 = pos(vrt_[f * 3 + 1]), &p2 = pos(vrt_[f * 3 + 2]);
+        vec3f n = cross(p1 - p0, p2 - p0);
+        const bool has_plane = n.norm() > 0;
+        if (has_plane) {
+            n.normalize();
+            for (int k = 0; k < 3; k++) quadrics_[vrt_[f * 3 + k]].add_plane(n, -dot(n, p0));
+        }
+        for (int k = 0; k < 3; k++) {
+            const std::uint32_t u = vrt_[f * 3 + k], v = vrt_[f * 3 + (k + 1) % 3];
+            vert_faces_[u].push_back(f);
+            edges.push_back({{std::min(u, v), std::max(u, v)}, has_plane ? f : UINT32_MAX});
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+
+    for (size_t i = 0; i < edges.size();) {
+        size_t j = i + 1;
+        while (j < edges.size() && edges[j].first == edges[i].first) j++;
+        const auto [u, v] = edges[i].first;
+        const std::uint32_t f = edges[i].second;
+        if (j - i == 1 && f != UINT32_MAX) {
+            const vec3f &p0 = pos(vrt_[f * 3]), &p1 = pos(vrt_[f * 3 + 1]), &p2 = pos(vrt_[f * 3 + 2]);
+            vec3f n = cross(cross(p1 - p0, p2 - p0), pos(v) - pos(u));
+            if (n.norm() > 0) {
+                n.normalize();
+                quadrics_[u].add_plane(n, -dot(n, pos(u)));
+                quadrics_[v].add_plane(n, -dot(n, pos(u)));
+            }
+        }
+        i = j;
+    }
+    for (std::uint32_t v = 0; v < vert_faces_.size(); v++) queue_best(v);
+}
+
+bool Simplifier::try_collapse(const Collapse &c)
+{
+    const std::uint32_t b = c.from, a = c.to;
+    if (!vert_alive_[a] || a == b) return false;
+
+    std::vector<std::uint32_t> &faces_a = faces_a_, &faces_b = faces_b_, &ring_a = ring_a_, &ring_b = ring_b_;
+    ring(a, faces_a, &ring_a);
+    ring(b, faces_b, &ring_b);
+
+    // tex coord (and normal) each corner of b takes, from the faces along the edge
+    auto &remap = remap_;
+    remap.clear();
+    size_t nshared = 0;
+    for (std::uint32_t f : faces_b) {
+        const int ka = corner(f, a);
+        if (ka < 0) continue;
+        nshared++;
+        const int kb = corner(f, b);
+        const int from = tex_[f * 3 + kb];
+        const std::pair<int, int> to = {tex_[f * 3 + ka], nrm_[f * 3 + ka]};
+        const auto it = std::find_if(remap.begin(), remap.end(), [&](const auto &r) { return r.first == from; });
+        if (it == remap.end()) remap.push_back({from, to});
+        else if (it->second.first != to.first) return false;
+    }
+    if (!nshared) return false;
+
+    // link condition : the only neighbours a and b share are the corners across their edge
+    size_t common = 0;
+    for (size_t i = 0, j = 0; i < ring_a.size() && j < ring_b.size();) {
+        if (ring_a[i] < ring_b[j]) i++;
+        else if (ring_a[i] > ring_b[j]) j++;
+        else common++, i++, j++;
+    }
+    if (common != nshared) return false;
+
+    // the faces b keeps must map their tex coords and not fold over
+    for (std::uint32_t f : faces_b) {
+        if (corner(f, a) >= 0) continue;
+        const int kb = corner(f, b);
+        const int t = tex_[f * 3 + kb];
+        if (std::none_of(remap.begin(), remap.end(), [&](const auto &r) { return r.first == t; })) return false;
+
+        vec3f p[3] = {pos(vrt_[f * 3]), pos(vrt_[f * 3 + 1]), pos(vrt_[f * 3 + 2])};
+        const vec3f before = cross(p[1] - p[0], p[2] - p[0]);
+        p[kb] = pos(a);
+        const vec3f after = cross(p[1] - p[0], p[2] - p[0]);
+        const double na = after.norm();
+        if (na <= 1e-12 * before.norm() || dot(before, after) < 0.2 * before.norm() * na) return false;
+    }
+
+    // collapse : faces along the edge go, the others move their corner of b onto a
+    for (std::uint32_t f : faces_b) {
+        if (corner(f, a) >= 0) {
+            face_alive_[f] = 0;
+            nfaces_--;
+            continue;
+        }
+        const int kb = corner(f, b);
+        const auto it = std::find_if(remap.begin(), remap.end(), [&](const auto &r) { return r.first == tex_[f * 3 + kb]; });
+        vrt_[f * 3 + kb] = a;
+        tex_[f * 3 + kb] = it->second.first;
+        nrm_[f * 3 + kb] = it->second.second;
+        faces_a.push_back(f);
+    }
+    vert_alive_[b] = 0;
+    quadrics_[a] += quadrics_[b];
+    error_ = std::max(error_, std::sqrt(c.cost));
+
+    // a's faces change, so do its collapses and the ones onto it. A neighbour only looks at all of its own again
+    // when its queued one was onto a or b, else collapsing onto a is the only one that moved
+    vert_faces_[a].clear();
+    for (std::uint32_t f : faces_a)
+        if (face_alive_[f]) vert_faces_[a].push_back(f);
+    vert_faces_[b].clear();
+    vert_faces_[b].shrink_to_fit();
+    ring(a, faces_a, &ring_a);
+    queue_best(a);
+    for (std::uint32_t v : ring_a) {
+        const Collapse &q = queued_[v];
+        if (q.to == a || q.to == b || q.to == UINT32_MAX) {
+            queue_best(v);
+            continue;
+        }
+        const double onto_a = cost(v, a);
+        if (!q.before(onto_a, a)) queue(Collapse{onto_a, v, a, 0});
+    }
+    return true;
+}
+
+bool Simplifier::run(const size_t target)
+{
+    while (nfaces_ > target) {
+        if (heap_.empty()) return false;
+        const Collapse c = heap_.top();
+        heap_.pop();
+        if (!vert_alive_[c.from] || c.stamp != stamps_[c.from]) continue;
+        if (!try_collapse(c)) queue_best(c.from, &c);
+    }
+    return true;
+}
+
+ObjMesh Simplifier::compact() const
+{
+    ObjMesh out;
+    std::vector<int> vmap(src_.verts.size(), -1), tmap(src_.uv.size(), -1), nmap(src_.norms.size(), -1);
+    auto remap = [](const int i, std::vector<int> &map, const auto &src, auto &dst) {
+        if (i < 0 || static_cast<size_t>(i) >= map.size()) return i;
+        if (map[i] < 0) {
+            map[i] = static_cast<int>(dst.size());
+            dst.push_back(src[i]);
+        }
+        return map[i];
+    };
+    out.facet_vrt.reserve(nfaces_ * 3);
+    out.facet_tex.reserve(nfaces_ * 3);
+    out.facet_nrm.reserve(nfaces_ * 3);
+    for (size_t f = 0; f < face_alive_.size(); f++) {
+        if (!face_alive_[f]) continue;
+        for (int k = 0; k < 3; k++) {
+            out.facet_vrt.push_back(remap(vrt_[f * 3 + k], vmap, src_.verts, out.verts));
+            out.facet_tex.push_back(remap(tex_[f * 3 + k], tmap, src_.uv, out.uv));
+            out.facet_nrm.push_back(remap(nrm_[f * 3 + k], nmap, src_.norms, out.norms));
+        }
+    }
+    return out;
+}
+
+}  // namespace
+
+std::vector<MeshLod> build_lod_chain(const MeshView &mesh, const int levels, const double ratio)
+{
+    std::vector<MeshLod> lods;
+    Simplifier simplifier(mesh);
+    for (int level = 0; level < levels; level++) {
+        const size_t before = simplifier.nfaces();
+        if (before == 0) break;
+        const bool reached = simplifier.run(static_cast<size_t>(before * ratio));
+        // a level that saved less than half of what was asked (or nothing at all) isn't worth its memory
+        const size_t after = simplifier.nfaces();
+        if (after == before || after > before - (before - before * ratio) / 2) break;
+        lods.push_back(MeshLod{simplifier.compact(), simplifier.error()});
+        if (!reached) break;
+    }
+    return lods;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <vector>
+#include "meshcache.h"
+#include "objparser.h"
+
+// One simplified copy of a mesh and how far it may stray from the original, in model units
+struct MeshLod
+{
+    ObjMesh mesh;
+    double error = 0;
+};
+
+/*
+	Mesh simplification by quadric error edge collapse (Garland & Heckbert)
+
+	--> every vertex starts with the sum of the squared distances to the planes of its faces (a 4x4 quadric), plus
+		a plane through every boundary edge perpendicular to its face so open borders don't creep inwards
+	--> edges are collapsed cheapest first : b goes onto a (the position of a is kept, no new vertices), a gets the
+		sum of both quadrics and the cost of collapsing b onto a is that sum evaluated at a. The heap holds the
+		cheapest collapse of every vertex rather than every edge (a quarter of the entries, which is what the time
+		goes to on big meshes) : a collapse queues a and its neighbours again and stamps their older entries
+		stale, a refused one queues the next cheapest of its vertex
+	--> a collapse is refused when it would fold a face over (its normal turning by more than ~80 degrees), make
+		the mesh non manifold (a and b sharing neighbours other than the corners across their edge) or tear the
+		uvs : the corners b loses take the tex coord a has in the faces along the edge, so b must not carry a tex
+		coord those faces don't map. A vertex on a uv seam thus only slides along the seam and the texture stays
+		put on either side of it. Normals follow the tex coords the same way
+	--> the error of a mesh is the square root of the largest cost collapsed to reach it, an upper bound of how far
+		any moved vertex lies from the original planes around it
+	--> surviving faces keep their order and their original positions, tex coords and normals, only the arrays are
+		compacted to what they still use
+*/
+// levels meshes, each with about ratio times the faces of the one before, stops early when collapses run out
+std::vector<MeshLod> build_lod_chain(const MeshView &mesh, const int levels, const double ratio);
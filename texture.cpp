@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include "texture.h"
+
+namespace
+{
+
+TextureFilter filter_from_env()
+{
+    if (const char *env = std::getenv("TEXTURE_FILTER")) {
+        if (!std::strcmp(env, "mip")) return TextureFilter::NearestMip;
+        if (!std::strcmp(env, "trilinear")) return TextureFilter::Trilinear;
+    }
+    return TextureFilter::Nearest;
+}
+
+inline int channel(const std::uint32_t c, const int i) { return c >> (i * 8) & 0xff; }
+
+// 2x2 box filter, the last texel of an odd sized row/column is folded into the last destination texel (3 taps)
+void downsample(const Texture::Level &src, Texture::Level &dst)
+{
+    for (int y = 0; y < dst.height(); y++) {
+        const int y0 = 2 * y, y1 = y + 1 < dst.height() ? 2 * y + 2 : src.height();
+        for (int x = 0; x < dst.width(); x++) {
+            const int x0 = 2 * x, x1 = x + 1 < dst.width() ? 2 * x + 2 : src.width();
+            const int n = (x1 - x0) * (y1 - y0);
+            int sum[4] = {};
+            for (int sy = y0; sy < y1; sy++)
+                for (int sx = x0; sx < x1; sx++)
+                    for (int i = 0; i < 4; i++) sum[i] += channel(src.texel(sx, sy), i);
+            std::uint32_t out = 0;
+            for (int i = 0; i < 4; i++) out |= static_cast<std::uint32_t>((sum[i] + n / 2) / n) << (i * 8);
+            dst.set(x, y, out);
+        }
+    }
+}
+
+}  // namespace
+
+TextureFilter texture_filter()
+{
+    static const TextureFilter f = filter_from_env();
+    return f;
+}
+
+const char *texture_filter_name(const TextureFilter f)
+{
+    switch (f) {
+        case TextureFilter::NearestMip: return "mip";
+        case TextureFilter::Trilinear: return "trilinear";
+        default: return "nearest";
+    }
+}
+
+const Texture::Level Texture::empty_level;
+
+Texture::Level::Level(const int width, const int height)
+    : tiles_(static_cast<size_t>((width + tile - 1) / tile) * ((height + tile - 1) / tile)), width_(width),
+      height_(height), tiles_x_((width + tile - 1) / tile)
+{}
+
+std::uint32_t Texture::Level::bilinear(const double u, const double v) const
+{
+    if (width_ == 0 || height_ == 0) return 0;
+    const double fx = u * width_ - 0.5, fy = v * height_ - 0.5;
+    const double flx = std::floor(fx), fly = std::floor(fy);
+    const int wx = static_cast<int>((fx - flx) * 256), wy = static_cast<int>((fy - fly) * 256);
+    const int x0 = static_cast<int>(std::clamp(flx, 0.0, width_ - 1.0));
+    const int y0 = static_cast<int>(std::clamp(fly, 0.0, height_ - 1.0));
+    const int x1 = static_cast<int>(std::clamp(flx + 1, 0.0, width_ - 1.0));
+    const int y1 = static_cast<int>(std::clamp(fly + 1, 0.0, height_ - 1.0));
+    return lerp(lerp(texel(x0, y0), texel(x1, y0), wx), lerp(texel(x0, y1), texel(x1, y1), wx), wy);
+}
+
+std::uint32_t Texture::lerp(const std::uint32_t a, const std::uint32_t b, const int w)
+{
+    std::uint32_t out = 0;
+    for (int i = 0; i < 4; i++) {
+        const int ca = channel(a, i), cb = channel(b, i);
+        out |= static_cast<std::uint32_t>(ca + (((cb - ca) * w + 128) >> 8)) << (i * 8);
+    }
+    return out;
+}
+
+Texture::Texture(const TGAImage &img)
+{
+    const int w = static_cast<int>(img.get_width()), h = static_cast<int>(img.get_height());
+    if (w == 0 || h == 0) return;
+    bytespp_ = static_cast<std::uint8_t>(img.get_bytespp());
+
+    Level base(w, h);
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            const TGAColor c = img.get(x, y);
+            std::uint32_t packed;
+            std::memcpy(&packed, c.bgra, 4);
+            base.set(x, y, packed);
+        }
+    }
+    levels_.push_back(std::move(base));
+
+    while (levels_.back().width() > 1 || levels_.back().height() > 1) {
+        const Level &src = levels_.back();
+        Level dst(std::max(1, src.width() / 2), std::max(1, src.height() / 2));
+        downsample(src, dst);
+        levels_.push_back(std::move(dst));
+    }
+}
+
+double Texture::lod(const double dudx, const double dvdx, const double dudy, const double dvdy) const
+{
+    const double rx = std::hypot(dudx * width(), dvdx * height());
+    const double ry = std::hypot(dudy * width(), dvdy * height());
+    const double l = std::log2(std::max(rx, ry));
+    return l > 0 ? l : 0;  // also catches a degenerate (zero or NaN) footprint
+}
+
+Texture::Sampler Texture::sampler(const double dudx, const double dvdx, const double dudy,
+                                  const double dvdy) const
+{
+    Sampler s;
+    s.filter = filter_;
+    s.fine = levels_.empty() ? &empty_level : &levels_[0];
+    if (levels_.empty() || filter_ == TextureFilter::Nearest) return s;
+
+    const double l = std::min(lod(dudx, dvdx, dudy, dvdy), levels() - 1.0);
+    if (filter_ == TextureFilter::NearestMip) {
+        s.fine = &levels_[static_cast<int>(l + 0.5)];
+        return s;
+    }
+    const int l0 = static_cast<int>(l);
+    s.fine = &levels_[l0];
+    s.coarse = &levels_[std::min(l0 + 1, levels() - 1)];
+    s.blend = static_cast<int>((l - l0) * 256);
+    return s;
+}
@@ -0,0 +1,142 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "tgaimage.h"
+
+// How a rasterizer samples a texture, see Texture::sampler()
+enum class TextureFilter
+{
+    Nearest,     // nearest texel of the full resolution image, what Model always did
+    NearestMip,  // nearest texel of the mip level closest to the triangle's footprint
+    Trilinear    // bilinear in the two levels around the footprint, blended by the fractional lod
+};
+
+TextureFilter texture_filter();  // default for new textures, TEXTURE_FILTER=nearest|mip|trilinear, else Nearest
+const char *texture_filter_name(const TextureFilter f);
+
+/*
+	Read only texture in a cache friendly layout, built once from a TGAImage at load time
+
+	--> texels are widened to 4 bytes (bgra as in TGAColor, missing channels are 0) and stored in 4x4 tiles, one
+		tile is exactly one 64 byte cache line and the tiles are laid out row by row. A diagonal walk through uv
+		space stays in the same line for 4 texels in either direction instead of touching a new row every step
+	--> every level is padded up to a multiple of 4 in both directions, the padding is never sampled
+	--> the full mip chain down to 1x1 is built with a 2x2 box filter when the texture is created (a third more
+		memory), a minified triangle then reads a level whose texels are about pixel sized instead of striding
+		across the full image
+	--> the rasterizers get a Sampler per triangle, the level of detail comes from the uv plane gradients which
+		are constant over a triangle (uv is interpolated linearly in screen space here)
+*/
+class Texture
+{
+public:
+    static constexpr int tile = 4;
+
+    class Level
+    {
+    private:
+        struct alignas(64) Tile
+        {
+            std::uint32_t texel[tile * tile];
+        };
+
+        std::vector<Tile> tiles_;
+        int width_{}, height_{};
+        int tiles_x_{};
+
+    public:
+        Level() = default;
+        Level(const int width, const int height);
+
+        int width() const { return width_; }
+        int height() const { return height_; }
+
+        // packed bgra of the texel at (x,y), which has to be inside the level, no checks
+        std::uint32_t texel(const int x, const int y) const
+        {
+            return tiles_[(y >> 2) * tiles_x_ + (x >> 2)].texel[(y & 3) << 2 | (x & 3)];
+        }
+        void set(const int x, const int y, const std::uint32_t c)
+        {
+            tiles_[(y >> 2) * tiles_x_ + (x >> 2)].texel[(y & 3) << 2 | (x & 3)] = c;
+        }
+
+        // texel under uv (x = u*width truncated), 0 (black) outside the level
+        std::uint32_t nearest(const double u, const double v) const
+        {
+            const auto x = static_cast<std::int64_t>(u * width_), y = static_cast<std::int64_t>(v * height_);
+            if (static_cast<std::uint64_t>(x) >= static_cast<std::uint64_t>(width_) ||
+                static_cast<std::uint64_t>(y) >= static_cast<std::uint64_t>(height_))
+                return 0;
+            return texel(static_cast<int>(x), static_cast<int>(y));
+        }
+
+        // 2x2 texels around uv weighted by distance to their centers, edges are clamped
+        std::uint32_t bilinear(const double u, const double v) const;
+    };
+
+    // Everything one triangle needs to sample, see sampler()
+    struct Sampler
+    {
+        const Level *fine = nullptr;
+        const Level *coarse = nullptr;  // trilinear only
+        int blend = 0;                  // weight of coarse in 1/256, trilinear only
+        TextureFilter filter = TextureFilter::Nearest;
+
+        std::uint32_t sample_bgra(const double u, const double v) const
+        {
+            if (filter != TextureFilter::Trilinear) return fine->nearest(u, v);
+            const std::uint32_t c0 = fine->bilinear(u, v);
+            return blend ? lerp(c0, coarse->bilinear(u, v), blend) : c0;
+        }
+    };
+
+private:
+    std::vector<Level> levels_;
+    std::uint8_t bytespp_{};
+    TextureFilter filter_ = texture_filter();
+
+    static const Level empty_level;
+
+public:
+    Texture() = default;
+    explicit Texture(const TGAImage &img);
+
+    int width() const { return levels_.empty() ? 0 : levels_[0].width(); }
+    int height() const { return levels_.empty() ? 0 : levels_[0].height(); }
+    int bytespp() const { return bytespp_; }
+    bool empty() const { return levels_.empty(); }
+    int levels() const { return static_cast<int>(levels_.size()); }
+    const Level &level(const int i) const { return levels_[i]; }
+
+    TextureFilter filter() const { return filter_; }
+    void set_filter(const TextureFilter f) { filter_ = f; }
+
+    // log2 of the texels covered by one pixel step, from the uv gradients along screen x and y
+    double lod(const double dudx, const double dvdx, const double dudy, const double dvdy) const;
+    Sampler sampler(const double dudx, const double dvdx, const double dudy, const double dvdy) const;
+
+    // nearest texel of the full resolution level, 0 (black) outside the image
+    std::uint32_t sample_bgra(const double u, const double v) const
+    {
+        return levels_.empty() ? 0 : levels_[0].nearest(u, v);
+    }
+
+    TGAColor sample(const double u, const double v) const
+    {
+        if (empty()) return {};
+        return to_color(sample_bgra(u, v));
+    }
+
+    TGAColor to_color(const std::uint32_t c) const
+    {
+        TGAColor ret;
+        std::memcpy(ret.bgra, &c, 4);
+        ret.bytespp = bytespp_;
+        return ret;
+    }
+
+    // per channel a + (b - a) * w / 256
+    static std::uint32_t lerp(const std::uint32_t a, const std::uint32_t b, const int w);
+};
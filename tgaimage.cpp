@@ -1,7 +1,15 @@
 #include <iostream>
 #include <fstream>
 #include <cstring>
+#include <cerrno>
+#include <climits>
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
 #include "tgaimage.h"
+#include "mappedfile.h"
+#include "threadpool.h"
 
 TGAImage::TGAImage() {}
 TGAImage::TGAImage(const size_t w, const size_t h, const size_t bpp)
@@ -10,203 +18,234 @@ TGAImage::TGAImage(const size_t w, const size_t h, const size_t bpp)
 
 bool TGAImage::read_tga_file(const std::string filename)
 {
-    std::ifstream in;
-    in.open(filename, std::ios::binary);
-    if (!in.is_open()) {
+    // --> the whole file is mapped and decoded from memory, no stream reads per pixel
+    MappedFile file(filename);
+    if (!file.is_open()) {
         std::cerr << "can't open file " << filename << "\n";
-        in.close();
         return false;
     }
+    const std::uint8_t *src = reinterpret_cast<const std::uint8_t *>(file.data());
+    size_t size = file.size();
     TGA_Header header{};
-    in.read(reinterpret_cast<char *>(&header), sizeof(header));
-    if (!in.good()) {
-        in.close();
+    if (size < sizeof(header)) {
         std::cerr << "an error occurred while reading the header\n";
         return false;
     }
+    std::memcpy(&header, src, sizeof(header));
     width = header.width;
     height = header.height;
     bytespp = header.bitsperpixel >> 3;
     if (width <= 0 || height <= 0 || (bytespp != GRAYSCALE && bytespp != RGB && bytespp != RGBA)) {
-        in.close();
         std::cerr << "bad bpp (or width/height) value\n";
         return false;
     }
+    // the image id and the color map (unused by true color / grayscale images) sit between header and pixels
+    const size_t skip = sizeof(header) + header.idlength +
+                        (header.colormaptype ? header.colormaplength * ((header.colormapdepth + 7) >> 3) : 0);
+    if (skip > size) {
+        std::cerr << "an error occurred while reading the header\n";
+        return false;
+    }
+    src += skip;
+    size -= skip;
+
     size_t nbytes = bytespp * width * height;
     data = std::vector<std::uint8_t>(nbytes, 0);
     if (3 == header.datatypecode || 2 == header.datatypecode) {
-        in.read(reinterpret_cast<char *>(data.data()), nbytes);
-        if (!in.good()) {
-            in.close();
+        if (size < nbytes) {
             std::cerr << "an error occurred while reading the data\n";
             return false;
         }
+        std::memcpy(data.data(), src, nbytes);
     } else if (10 == header.datatypecode || 11 == header.datatypecode) {
-        if (!load_rle_data(in)) {
-            in.close();
+        if (!load_rle_data(src, size)) {
             std::cerr << "an error occurred while reading the data\n";
             return false;
         }
     } else {
-        in.close();
         std::cerr << "unknown file format " << (size_t)header.datatypecode << "\n";
         return false;
     }
     if (!(header.imagedescriptor & 0x20)) flip_vertically();
     if (header.imagedescriptor & 0x10) flip_horizontally();
     std::cerr << width << "x" << height << "/" << bytespp * 8 << "\n";
-    in.close();
     return true;
 }
 
-bool TGAImage::load_rle_data(std::ifstream &in)
+/*
+    RLE packets straight from the mapped file
+    --> raw packet : 1 header byte (count-1) then count pixels, one memcpy
+    --> run packet : 1 header byte (128 + count-1) then one pixel repeated count times, the first copy is written
+        and then doubled with memcpy (1, 2, 4, ... pixels) so a long run is a handful of wide copies
+    --> a packet that needs more bytes than are left, or more pixels than the image has, rejects the file
+*/
+bool TGAImage::load_rle_data(const std::uint8_t *src, const size_t size)
 {
-    size_t pixelcount = width * height;
-    size_t currentpixel = 0;
-    size_t currentbyte = 0;
-    TGAColor colorbuffer;
-    do {
-        std::uint8_t chunkheader = 0;
-        chunkheader = in.get();
-        if (!in.good()) {
+    const std::uint8_t *const end = src + size;
+    std::uint8_t *dst = data.data();
+    std::uint8_t *const dst_end = dst + data.size();
+    while (dst < dst_end) {
+        if (src >= end) {
             std::cerr << "an error occurred while reading the data\n";
             return false;
         }
+        const std::uint8_t chunkheader = *src++;
+        const size_t count = (chunkheader & 0x7f) + 1;
+        const size_t nbytes = count * bytespp;
+        if (nbytes > static_cast<size_t>(dst_end - dst)) {
+            std::cerr << "Too many pixels read\n";
+            return false;
+        }
         if (chunkheader < 128) {
-            chunkheader++;
-            for (size_t i = 0; i < chunkheader; i++) {
-                in.read(reinterpret_cast<char *>(colorbuffer.bgra), bytespp);
-                if (!in.good()) {
-                    std::cerr << "an error occurred while reading the header\n";
-                    return false;
-                }
-                for (size_t t = 0; t < bytespp; t++) data[currentbyte++] = colorbuffer.bgra[t];
-                currentpixel++;
-                if (currentpixel > pixelcount) {
-                    std::cerr << "Too many pixels read\n";
-                    return false;
-                }
+            if (nbytes > static_cast<size_t>(end - src)) {
+                std::cerr << "an error occurred while reading the header\n";
+                return false;
             }
+            std::memcpy(dst, src, nbytes);
+            src += nbytes;
         } else {
-            chunkheader -= 127;
-            in.read(reinterpret_cast<char *>(colorbuffer.bgra), bytespp);
-            if (!in.good()) {
+            if (bytespp > static_cast<size_t>(end - src)) {
                 std::cerr << "an error occurred while reading the header\n";
                 return false;
             }
-            for (size_t i = 0; i < chunkheader; i++) {
-                for (size_t t = 0; t < bytespp; t++) data[currentbyte++] = colorbuffer.bgra[t];
-                currentpixel++;
-                if (currentpixel > pixelcount) {
-                    std::cerr << "Too many pixels read\n";
-                    return false;
-                }
-            }
+            std::memcpy(dst, src, bytespp);
+            src += bytespp;
+            for (size_t filled = bytespp; filled < nbytes; filled *= 2)
+                std::memcpy(dst + filled, dst, std::min(filled, nbytes - filled));
         }
-    } while (currentpixel < pixelcount);
+        dst += nbytes;
+    }
     return true;
 }
 
-bool TGAImage::write_tga_file(const std::string filename, const bool v_flip, const bool rle) const
+namespace
 {
-    std::uint8_t developer_area_ref[4] = {0, 0, 0, 0};
-    std::uint8_t extension_area_ref[4] = {0, 0, 0, 0};
-    std::uint8_t footer[18] = {'T', 'R', 'U', 'E', 'V', 'I', 'S', 'I', 'O',
-                               'N', '-', 'X', 'F', 'I', 'L', 'E', '.', '\0'};
-    std::ofstream out;
-    out.open(filename, std::ios::binary);
-    if (!out.is_open()) {
-        std::cerr << "can't open file " << filename << "\n";
-        out.close();
-        return false;
+
+const size_t rows_per_band = 64;  // rows encoded by one job of the writer
+
+// Writes all parts to fd with as few writev calls as the kernel allows, partial writes are resumed
+bool write_parts(const int fd, std::vector<iovec> parts)
+{
+    size_t first = 0;
+    while (first < parts.size()) {
+        const int n = static_cast<int>(std::min<size_t>(parts.size() - first, IOV_MAX));
+        ssize_t done = writev(fd, parts.data() + first, n);
+        if (done < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        while (first < parts.size() && static_cast<size_t>(done) >= parts[first].iov_len)
+            done -= parts[first++].iov_len;
+        if (first < parts.size()) {
+            parts[first].iov_base = static_cast<char *>(parts[first].iov_base) + done;
+            parts[first].iov_len -= done;
+        }
     }
+    return true;
+}
+
+/*
+    RLE encodes pixels [begin,end) and appends the packets to out, bpp is a template parameter so the pixel
+    compares and copies compile to plain loads
+    --> a run packet is used from 2 equal pixels on for 3/4 byte pixels, for grayscale only from 3 on : a 2 pixel
+        run inside raw data costs 2*bpp bytes left in place and bpp+2 bytes split out (run header and pixel plus
+        the header of the raw packet that follows)
+    --> raw packets are copied with one insert each
+*/
+template <size_t bpp>
+void encode_rle_pixels(const std::uint8_t *px, const size_t begin, const size_t end, std::vector<std::uint8_t> &out)
+{
+    const size_t max_chunk_length = 128;
+    const size_t min_run = bpp > 2 ? 2 : 3;
+    auto same = [&](const size_t a, const size_t b) { return !std::memcmp(px + a * bpp, px + b * bpp, bpp); };
+    // equal pixels starting at i, at most limit
+    auto run_at = [&](const size_t i, const size_t limit) {
+        size_t n = 1;
+        while (n < limit && i + n < end && same(i, i + n)) n++;
+        return n;
+    };
+
+    out.reserve(out.size() + (end - begin) * bpp / 2);
+    size_t i = begin;
+    while (i < end) {
+        const size_t run = run_at(i, max_chunk_length);
+        if (run >= min_run) {
+            out.push_back(static_cast<std::uint8_t>(run + 127));
+            out.insert(out.end(), px + i * bpp, px + (i + 1) * bpp);
+            i += run;
+            continue;
+        }
+        const size_t start = i;
+        while (i < end && i - start < max_chunk_length && (i == start || run_at(i, min_run) < min_run)) i++;
+        out.push_back(static_cast<std::uint8_t>(i - start - 1));
+        out.insert(out.end(), px + start * bpp, px + i * bpp);
+    }
+}
+
+}  // namespace
+
+/*
+    Header, pixel data and footer go out with writev, straight from where they live
+    --> without rle the pixel part is the framebuffer itself, nothing is copied
+    --> with rle, bands of rows_per_band rows are encoded into their own buffers (in parallel when a pool is
+        given, packets never cross a band), the bands are then handed to writev in order as one write
+*/
+bool TGAImage::write_tga_file(const std::string filename, const bool v_flip, const bool rle,
+                              ThreadPool *pool) const
+{
+    static const std::uint8_t developer_area_ref[4] = {0, 0, 0, 0};
+    static const std::uint8_t extension_area_ref[4] = {0, 0, 0, 0};
+    static const std::uint8_t footer[18] = {'T', 'R', 'U', 'E', 'V', 'I', 'S', 'I', 'O',
+                                            'N', '-', 'X', 'F', 'I', 'L', 'E', '.', '\0'};
     TGA_Header header;
     header.bitsperpixel = bytespp << 3;
     header.width = width;
     header.height = height;
     header.datatypecode = (bytespp == GRAYSCALE ? (rle ? 11 : 3) : (rle ? 10 : 2));
     header.imagedescriptor = v_flip ? 0x00 : 0x20;  // top-left or bottom-left origin
-    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
-    if (!out.good()) {
-        out.close();
-        std::cerr << "can't dump the tga file\n";
-        return false;
-    }
+
+    auto part = [](const void *p, const size_t n) { return iovec{const_cast<void *>(p), n}; };
+    std::vector<iovec> parts{part(&header, sizeof(header))};
+    std::vector<std::vector<std::uint8_t>> bands;
     if (!rle) {
-        out.write(reinterpret_cast<const char *>(data.data()), width * height * bytespp);
-        if (!out.good()) {
-            std::cerr << "can't unload raw data\n";
-            out.close();
-            return false;
-        }
+        parts.push_back(part(data.data(), width * height * bytespp));
     } else {
-        if (!unload_rle_data(out)) {
-            out.close();
-            std::cerr << "can't unload rle data\n";
-            return false;
+        bands.resize((height + rows_per_band - 1) / rows_per_band);
+        auto encode = [&](size_t i) {
+            const size_t y0 = i * rows_per_band, y1 = std::min<size_t>(height, y0 + rows_per_band);
+            encode_rle(y0 * width, y1 * width, bands[i]);
+        };
+        if (pool) {
+            pool->parallel_for(bands.size(), encode);
+        } else {
+            for (size_t i = 0; i < bands.size(); i++) encode(i);
         }
+        for (const auto &band : bands) parts.push_back(part(band.data(), band.size()));
     }
-    out.write(reinterpret_cast<const char *>(developer_area_ref), sizeof(developer_area_ref));
-    if (!out.good()) {
-        std::cerr << "can't dump the tga file\n";
-        out.close();
-        return false;
-    }
-    out.write(reinterpret_cast<const char *>(extension_area_ref), sizeof(extension_area_ref));
-    if (!out.good()) {
-        std::cerr << "can't dump the tga file\n";
-        out.close();
+    parts.push_back(part(developer_area_ref, sizeof(developer_area_ref)));
+    parts.push_back(part(extension_area_ref, sizeof(extension_area_ref)));
+    parts.push_back(part(footer, sizeof(footer)));
+
+    const int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "can't open file " << filename << "\n";
         return false;
     }
-    out.write(reinterpret_cast<const char *>(footer), sizeof(footer));
-    if (!out.good()) {
+    const bool ok = write_parts(fd, std::move(parts));
+    if (close(fd) != 0 || !ok) {
         std::cerr << "can't dump the tga file\n";
-        out.close();
         return false;
     }
-    out.close();
     return true;
 }
 
-// TODO: it is not necessary to break a raw chunk for two equal pixels (for the matter of the
-// resulting size)
-bool TGAImage::unload_rle_data(std::ofstream &out) const
+void TGAImage::encode_rle(const size_t begin, const size_t end, std::vector<std::uint8_t> &out) const
 {
-    const std::uint8_t max_chunk_length = 128;
-    size_t n_pixels = width * height;
-    size_t curpix = 0;
-    while (curpix < n_pixels) {
-        size_t chunkstart = curpix * bytespp;
-        size_t curbyte = curpix * bytespp;
-        std::uint8_t run_length = 1;
-        bool raw = true;
-        while (curpix + run_length < n_pixels && run_length < max_chunk_length) {
-            bool succ_eq = true;
-            for (size_t t = 0; succ_eq && t < bytespp; t++)
-                succ_eq = (data[curbyte + t] == data[curbyte + t + bytespp]);
-            curbyte += bytespp;
-            if (1 == run_length) raw = !succ_eq;
-            if (raw && succ_eq) {
-                run_length--;
-                break;
-            }
-            if (!raw && !succ_eq) break;
-            run_length++;
-        }
-        curpix += run_length;
-        out.put(raw ? run_length - 1 : run_length + 127);
-        if (!out.good()) {
-            std::cerr << "can't dump the tga file\n";
-            return false;
-        }
-        out.write(reinterpret_cast<const char *>(data.data() + chunkstart),
-                  (raw ? run_length * bytespp : bytespp));
-        if (!out.good()) {
-            std::cerr << "can't dump the tga file\n";
-            return false;
-        }
+    switch (bytespp) {
+        case GRAYSCALE: encode_rle_pixels<GRAYSCALE>(data.data(), begin, end, out); break;
+        case RGB: encode_rle_pixels<RGB>(data.data(), begin, end, out); break;
+        default: encode_rle_pixels<RGBA>(data.data(), begin, end, out); break;
     }
-    return true;
 }
 
 TGAColor TGAImage::get(const size_t x, const size_t y) const
@@ -221,7 +260,7 @@ void TGAImage::set(size_t x, size_t y, const TGAColor &c)
     memcpy(data.data() + (x + y * width) * bytespp, c.bgra, bytespp);
 }
 
-size_t TGAImage::get_bytespp() { return bytespp; }
+size_t TGAImage::get_bytespp() const { return bytespp; }
 
 size_t TGAImage::get_width() const { return width; }
 
@@ -258,7 +297,9 @@ void TGAImage::flip_vertically()
 
 std::uint8_t *TGAImage::buffer() { return data.data(); }
 
-void TGAImage::clear() { data = std::vector<std::uint8_t>(width * height * bytespp, 0); }
+const std::uint8_t *TGAImage::buffer() const { return data.data(); }
+
+void TGAImage::clear() { std::fill(data.begin(), data.end(), 0); }
 
 void TGAImage::scale(size_t w, size_t h)
 {
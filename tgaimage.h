@@ -4,6 +4,8 @@
 #include <fstream>
 #include <vector>
 
+class ThreadPool;
+
 #pragma pack(push, 1)
 struct TGA_Header
 {
@@ -57,8 +59,8 @@ protected:
     uint32_t height{};
     uint32_t bytespp{};
 
-    bool load_rle_data(std::ifstream &in);
-    bool unload_rle_data(std::ofstream &out) const;
+    bool load_rle_data(const std::uint8_t *src, const size_t size);
+    void encode_rle(const size_t begin, const size_t end, std::vector<std::uint8_t> &out) const;
 
 public:
     enum Format
@@ -71,8 +73,9 @@ public:
     TGAImage();
     TGAImage(const size_t w, const size_t h, const size_t bpp);
     bool read_tga_file(const std::string filename);
-    bool write_tga_file(const std::string filename, const bool v_flip = true,
-                        const bool rle = true) const;
+    // rle bands are encoded on pool when one is given, rle = false writes the pixels without copying them
+    bool write_tga_file(const std::string filename, const bool v_flip = true, const bool rle = true,
+                        ThreadPool *pool = nullptr) const;
     void flip_horizontally();
     void flip_vertically();
     void scale(const size_t w, const size_t h);
@@ -80,7 +83,8 @@ public:
     void set(const size_t x, const size_t y, const TGAColor &c);
     size_t get_width() const;
     size_t get_height() const;
-    size_t get_bytespp();
+    size_t get_bytespp() const;
     std::uint8_t *buffer();
+    const std::uint8_t *buffer() const;
     void clear();
 };
@@ -0,0 +1,65 @@
+#include "threadpool.h"
+
+static thread_local size_t current_worker = 0;
+
+ThreadPool::ThreadPool(size_t nthreads) {
+	if (nthreads == 0) nthreads = 1;
+	// the caller is a worker too, so spawn one thread less
+	for (size_t i = 1; i < nthreads; i++) workers_.emplace_back(&ThreadPool::worker_loop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		stop_ = true;
+	}
+	wake_.notify_all();
+	for (auto &t : workers_) t.join();
+}
+
+size_t ThreadPool::size() const { return workers_.size() + 1; }
+
+void ThreadPool::drain() {
+	for (size_t i = next_++; i < job_count_; i = next_++) (*job_)(i);
+}
+
+size_t ThreadPool::worker_index() { return current_worker; }
+
+void ThreadPool::worker_loop(const size_t index) {
+	current_worker = index;
+	size_t seen = 0;
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(mtx_);
+			wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+			if (stop_) return;
+			seen = generation_;
+		}
+		drain();
+		{
+			std::lock_guard<std::mutex> lock(mtx_);
+			if (--busy_ == 0) done_.notify_one();
+		}
+	}
+}
+
+void ThreadPool::parallel_for(size_t count, const std::function<void(size_t)> &fn) {
+	if (count == 0) return;
+	if (workers_.empty() || count == 1) {
+		for (size_t i = 0; i < count; i++) fn(i);
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		job_ = &fn;
+		job_count_ = count;
+		next_ = 0;
+		busy_ = workers_.size();
+		generation_++;
+	}
+	wake_.notify_all();
+	drain();
+	std::unique_lock<std::mutex> lock(mtx_);
+	done_.wait(lock, [&] { return busy_ == 0; });
+	job_ = nullptr;
+}
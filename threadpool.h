@@ -0,0 +1,47 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+	Minimal fork/join thread pool.
+
+	--> parallel_for(n, fn) calls fn(i) for every i in [0,n) and blocks until all calls returned
+	--> work items are handed out one at a time through an atomic counter, so a slow item (a tile
+		full of triangles) doesn't stall the other workers
+	--> the calling thread also takes items, so a pool of size 1 runs everything inline
+	--> every thread of the pool has an index in [0, size()), the caller's is 0, so work items can pick per thread
+		scratch memory with worker_index()
+*/
+class ThreadPool {
+private:
+	std::vector<std::thread> workers_;
+	std::mutex mtx_;
+	std::condition_variable wake_;
+	std::condition_variable done_;
+
+	const std::function<void(size_t)> *job_ = nullptr;
+	size_t job_count_ = 0;
+	std::atomic<size_t> next_{0};
+	size_t busy_ = 0;           // workers still inside the current job
+	size_t generation_ = 0;     // bumped for every job so sleeping workers notice a new one
+	bool stop_ = false;
+
+	void worker_loop(const size_t index);
+	void drain();
+
+public:
+	explicit ThreadPool(size_t nthreads = std::thread::hardware_concurrency());
+	~ThreadPool();
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator=(const ThreadPool &) = delete;
+
+	size_t size() const;  // number of threads taking part in a job, including the caller
+	void parallel_for(size_t count, const std::function<void(size_t)> &fn);
+	// index of the pool thread running the calling work item, 0 outside of a job
+	static size_t worker_index();
+};
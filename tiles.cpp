@@ -0,0 +1,33 @@
+#include <algorithm>
+#include "tiles.h"
+
+TileBinner::TileBinner(const int width, const int height, const int tile_size)
+	: width_(width), height_(height), tile_size_(tile_size),
+	  tiles_x_((width + tile_size - 1) / tile_size), tiles_y_((height + tile_size - 1) / tile_size),
+	  bins_(tiles_x_ * tiles_y_) {}
+
+void TileBinner::clear() {
+	for (auto &b : bins_) b.clear();  // keeps the capacity around for the next frame
+}
+
+void TileBinner::bin(const uint32_t id, const int xmin, const int ymin, const int xmax, const int ymax) {
+	if (xmin > xmax || ymin > ymax) return;
+	const int tx0 = std::max(0, xmin / tile_size_), tx1 = std::min(tiles_x_ - 1, xmax / tile_size_);
+	const int ty0 = std::max(0, ymin / tile_size_), ty1 = std::min(tiles_y_ - 1, ymax / tile_size_);
+	for (int ty = ty0; ty <= ty1; ty++)
+		for (int tx = tx0; tx <= tx1; tx++) bins_[tx + ty * tiles_x_].push_back(id);
+}
+
+size_t TileBinner::ntiles() const { return bins_.size(); }
+
+Tile TileBinner::tile(const size_t idx) const {
+	const int tx = idx % tiles_x_, ty = idx / tiles_x_;
+	Tile t;
+	t.x0 = tx * tile_size_;
+	t.y0 = ty * tile_size_;
+	t.x1 = std::min(width_, t.x0 + tile_size_) - 1;
+	t.y1 = std::min(height_, t.y0 + tile_size_) - 1;
+	return t;
+}
+
+const std::vector<uint32_t> &TileBinner::tris(const size_t idx) const { return bins_[idx]; }
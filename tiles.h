@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Screen rectangle owned by one tile, bounds are inclusive pixel coords
+struct Tile {
+	int x0{}, y0{}, x1{}, y1{};
+};
+
+/*
+	Bins triangles into fixed size screen tiles.
+
+	--> every triangle id is appended to the bin of each tile its pixel bbox touches, so within a bin
+		triangles keep their submission order
+	--> since a pixel belongs to exactly one tile and each tile replays its triangles in order, the
+		tiles can be rasterized independently (and in parallel) with the same result as a single
+		front-to-back walk over all faces
+*/
+class TileBinner {
+private:
+	int width_{}, height_{};
+	int tile_size_{};
+	int tiles_x_{}, tiles_y_{};
+	std::vector<std::vector<uint32_t>> bins_;
+
+public:
+	// tile_size should be a multiple of the coarse depth block (8) so no depth block straddles two tiles
+	TileBinner(const int width, const int height, const int tile_size = 64);
+	void clear();
+	// xmin..xmax and ymin..ymax is the inclusive pixel bbox of triangle `id`, already clamped to the screen
+	void bin(const uint32_t id, const int xmin, const int ymin, const int xmax, const int ymax);
+	int tile_size() const { return tile_size_; }
+	size_t ntiles() const;
+	Tile tile(const size_t idx) const;
+	const std::vector<uint32_t> &tris(const size_t idx) const;
+};
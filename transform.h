@@ -4,7 +4,7 @@
 const float pi = 3.1415926535897932385;
 #define DEG2RAD pi/180.0
 
-mat4 viewport(int x_v , int y_v , int w , int h , int depth){
+inline mat4 viewport(int x_v , int y_v , int w , int h , int depth){
 /*
 	Function that produces a matrix that would transform world coords to screen coords
 		--> It maps the following coord ranges in world space to screen space:
@@ -59,7 +59,7 @@ mat4 viewport(int x_v , int y_v , int w , int h , int depth){
 
 }
 
-mat4 lookat(vec3f camPos, vec3f targetPos,vec3f globalUp = vec3f(0.0,1.0,0.0)){
+inline mat4 lookat(vec3f camPos, vec3f targetPos,vec3f globalUp = vec3f(0.0,1.0,0.0)){
 /*	
 	The Camera Transform or The View Matrix
 
@@ -121,7 +121,7 @@ mat4 lookat(vec3f camPos, vec3f targetPos,vec3f globalUp = vec3f(0.0,1.0,0.0)){
 	return R*T;
 }
 
-mat4 projection(float l, float r, float b, float t, float n, float f)
+inline mat4 projection(float l, float r, float b, float t, float n, float f)
 {
     mat4 P = mat4::identity(); // Persepective transform to transform frustum into viewing cube , includes the transformation to transform viewing cube to bi-unit cube, for more details checkout http://www.songho.ca/opengl/gl_projectionmatrix.html
 
@@ -140,7 +140,7 @@ mat4 projection(float l, float r, float b, float t, float n, float f)
     return P;
 }
 
-mat4 projection(float v_fov, float aspectRatio, float front, float back){
+inline mat4 projection(float v_fov, float aspectRatio, float front, float back){
 	float theta = v_fov*DEG2RAD;
 	float tangent = tanf(theta/2);		   		// tangent of half v_fov
     float height = front * tangent;             // half height of near plane
@@ -1,10 +1,16 @@
 #pragma once
 #include "tgaimage.h"
 #include "geometry.h"
+#include "model.h"
+#include "tiles.h"
+#include "depthbuffer.h"
+#include "raster_simd.h"
+#include "trianglesetup.h"
+#include "shader.h"
 #include <limits>
 
 /*	Bresenham's Line Drawing Algorithm	*/
-void linelow(int x0 , int y0 , int x1, int y1 , TGAImage &image , const TGAColor& color){
+inline void linelow(int x0 , int y0 , int x1, int y1 , TGAImage &image , const TGAColor& color){
 
 	int dx = x1 - x0;
 	int dy = y1 - y0;
@@ -31,7 +37,7 @@ void linelow(int x0 , int y0 , int x1, int y1 , TGAImage &image , const TGAColor
 	}
 }
 
-void linehigh(int x0 , int y0 , int x1, int y1 , TGAImage &image , const TGAColor& color){
+inline void linehigh(int x0 , int y0 , int x1, int y1 , TGAImage &image , const TGAColor& color){
 
 	int dx = x1 - x0;
 	int dy = y1 - y0;
@@ -59,7 +65,7 @@ void linehigh(int x0 , int y0 , int x1, int y1 , TGAImage &image , const TGAColo
 	}
 }
 
-void line(int x0 , int y0 , int x1, int y1 , TGAImage &image , const TGAColor& color){	
+inline void line(int x0 , int y0 , int x1, int y1 , TGAImage &image , const TGAColor& color){	
 	
 	//slope < 1
 	if(abs(y1-y0) < abs(x1-x0)){
@@ -74,132 +80,186 @@ void line(int x0 , int y0 , int x1, int y1 , TGAImage &image , const TGAColor& c
 	}
 }
 
-void line(vec2i p0, vec2i p1, TGAImage &image, TGAColor color){
+inline void line(vec2i p0, vec2i p1, TGAImage &image, TGAColor color){
 	line(p0.x,p0.y,p1.x,p1.y,image,color);
 }
 
-vec3f barycentric(vec3f* pts, vec3i P) {
-	vec3f bc = cross(	vec3f(pts[2][0] - pts[0][0], pts[1][0] - pts[0][0], pts[0][0] - P[0]),
-						vec3f(pts[2][1] - pts[0][1], pts[1][1] - pts[0][1], pts[0][1] - P[1])
-					);
-	if (std::abs(bc[2]) < 1) return vec3f(-1, 1, 1);
-	
-	return vec3f(1.0f - (bc.x + bc.y) / bc.z, bc.y / bc.z, bc.x / bc.z);
-}
-
-
-
-void untex_triangle(vec3f* pts, double *zbuffer, TGAImage& image, TGAColor color) {
-
-	const int width = image.get_width();
-	// const int height = image.get_height();
-
-	vec2f bboxmin( std::numeric_limits<float>::max(),  std::numeric_limits<float>::max());
-	vec2f bboxmax(-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max());
-	vec2f extra(image.get_width() - 1, image.get_height() - 1);
-
-
-	//Calculating the bounding box
-	for (int i = 0; i < 3; i++) {
-		for (int j = 0; j < 2; j++) {
-			bboxmin[j] = std::max(0.0		  , std::min(bboxmin[j], pts[i][j]));
-			bboxmax[j] = std::min(extra[j], std::max(bboxmax[j], pts[i][j]));
-		}
+//Reference one pixel at a time kernel, the SIMD kernels in raster_simd.cpp must match what it draws
+//clip restricts drawing to a screen rectangle, the tiled renderer passes the tile being rasterized
+template <Shader S, DepthBuffer::Format F>
+inline bool raster_scalar(const S &shader, const typename S::Face &face, const TriangleSetup &t, DepthBuffer &zb, TGAImage &image, const Tile &clip) {
+
+	const int width = image.get_width(), bpp = image.get_bytespp();
+	std::uint8_t *buffer = image.buffer();
+	auto *zbuffer = zb.data<typename DepthStorage<F>::type>();
+
+	const int xmin = std::max(clip.x0, t.xmin), xmax = std::min(clip.x1, t.xmax);
+	const int ymin = std::max(clip.y0, t.ymin), ymax = std::min(clip.y1, t.ymax);
+	if (xmin > xmax || ymin > ymax) return false;
+	bool wrote = false;
+	const typename S::Bound bound = shader.bind(t, face);
+
+	//Values at the first pixel of the first row, stepped down the rows with the b coefficients
+	double w0_row = t.w[0].at(xmin, ymin), w1_row = t.w[1].at(xmin, ymin), w2_row = t.w[2].at(xmin, ymin);
+	double z_row = t.z.at(xmin, ymin), u_row = 0, v_row = 0;
+	if constexpr (S::uses_uv) {
+		u_row = t.u.at(xmin, ymin);
+		v_row = t.v.at(xmin, ymin);
 	}
 
-	//Draw bbox
-	// const TGAColor white = TGAColor(255, 255, 255, 255);
-	// const TGAColor red = TGAColor(255, 0, 0, 255);
-	// const TGAColor green = TGAColor(0, 255, 0, 255);
-	// const TGAColor blue = TGAColor(0, 0, 255, 255);	
-	// line(bboxmin.x,bboxmin.y,bboxmin.x,bboxmax.y,image,red);
-	// line(bboxmin.x,bboxmax.y,bboxmax.x,bboxmax.y,image,red);
-	// line(bboxmax.x,bboxmax.y,bboxmax.x,bboxmin.y,image,red);
-	// line(bboxmax.x,bboxmin.y,bboxmin.x,bboxmin.y,image,red);
-
-
-	//Iterate over the bbox , and check if each pixel is in the triangle , and if it is in calculate and update coresponding z-values and z-buffer
-	vec3i P;
-
-	for (P.x = bboxmin.x; P.x <= bboxmax.x; P.x++) {
-		for (P.y = bboxmin.y; P.y <= bboxmax.y; P.y++) {
-
-			//get the bary_coords for point P
-			vec3f bc_screen = barycentric(pts, P);
-
-			//Check if inside triangle
-			if (bc_screen.x < 0 || bc_screen.y < 0 || bc_screen.z < 0) continue;
-			
-			//Calculating z - value
-			P.z = 0;
-			for (int i = 0; i < 3; i++) {
-				P.z += static_cast<int>(pts[i].z * bc_screen[i]);
-				// z value is calculated as sum of products : of z-coords of triangle's vertices and coresponding bary_coords
+	for (int y = ymin; y <= ymax; y++) {
+		double w0 = w0_row, w1 = w1_row, w2 = w2_row;
+		double z = z_row, u = u_row, v = v_row;
+		bool entered = false;
+
+		for (int x = xmin; x <= xmax; x++) {
+			//Check if inside triangle, the covered part of a row is contiguous so once we leave it we are done with the row
+			if (w0 >= 0 && w1 >= 0 && w2 >= 0) {
+				entered = true;
+				const double pz = zb.encode(std::trunc(z));
+
+				//Update z-buffer with pixel closest to the camera(farthest from screen)
+				if (zbuffer[x + y * width] < pz) {
+					zbuffer[x + y * width] = pz;
+					wrote = true;
+
+					//the fragment stage only runs once the pixel survived the z-test
+					const std::uint32_t c = shader.fragment(bound, x, y, u, v);
+					std::memcpy(buffer + (x + y * width) * bpp, &c, bpp);
+				}
 			}
+			else if (entered) break;
 
-			//Update z-buffer with pixel closest to the camera(farthest from screen)
-			if (zbuffer[int(P.x + P.y * width)] < P.z) {
-				zbuffer[int(P.x + P.y * width)] = P.z;
-				image.set(static_cast<int>(P.x), static_cast<int>(P.y), color);
+			w0 += t.w[0].a;	w1 += t.w[1].a;	w2 += t.w[2].a;
+			z += t.z.a;
+			if constexpr (S::uses_uv) {
+				u += t.u.a;	v += t.v.a;
 			}
 		}
+
+		w0_row += t.w[0].b;	w1_row += t.w[1].b;	w2_row += t.w[2].b;
+		z_row += t.z.b;
+		if constexpr (S::uses_uv) {
+			u_row += t.u.b;	v_row += t.v.b;
+		}
 	}
+	return wrote;
 }
 
+//Depth only reference kernel (shadow maps), the raster loop with everything but the depth test taken out
+template <DepthBuffer::Format F>
+inline bool depth_scalar(const TriangleSetup &t, DepthBuffer &zb, const Tile &clip) {
 
+	const int width = zb.width();
+	auto *zbuffer = zb.data<typename DepthStorage<F>::type>();
 
+	const int xmin = std::max(clip.x0, t.xmin), xmax = std::min(clip.x1, t.xmax);
+	const int ymin = std::max(clip.y0, t.ymin), ymax = std::min(clip.y1, t.ymax);
+	if (xmin > xmax || ymin > ymax) return false;
+	bool wrote = false;
 
-//Input array of vertex coords, array of uv coords , model and rest
-void triangle(vec3f *pts, vec2f *uvs, double *zbuffer, TGAImage &image, Model *model){
-	
-	const int width = image.get_width();
-	// const int height = image.get_height();
+	double w0_row = t.w[0].at(xmin, ymin), w1_row = t.w[1].at(xmin, ymin), w2_row = t.w[2].at(xmin, ymin);
+	double z_row = t.z.at(xmin, ymin);
 
-	vec2f bboxmin(std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
-    vec2f bboxmax(std::numeric_limits<float>::min(), std::numeric_limits<float>::min());
-	vec2f extra(image.get_width() - 1, image.get_height() - 1);
+	for (int y = ymin; y <= ymax; y++) {
+		double w0 = w0_row, w1 = w1_row, w2 = w2_row, z = z_row;
+		bool entered = false;
 
+		for (int x = xmin; x <= xmax; x++) {
+			if (w0 >= 0 && w1 >= 0 && w2 >= 0) {
+				entered = true;
+				const double pz = zb.encode(std::trunc(z));
+				if (zbuffer[x + y * width] < pz) {
+					zbuffer[x + y * width] = pz;
+					wrote = true;
+				}
+			}
+			else if (entered) break;
 
-	//Calculating the bounding box
-	for (int i = 0; i < 3; i++) {
-        for (int j = 0; j < 2; j++) {
-			bboxmin[j] = std::max(0.0		  , std::min(bboxmin[j], pts[i][j]));
-			bboxmax[j] = std::min(extra[j], std::max(bboxmax[j], pts[i][j]));
+			w0 += t.w[0].a;	w1 += t.w[1].a;	w2 += t.w[2].a;
+			z += t.z.a;
 		}
-    }
-
-	vec3i P;
-	for (P.x = bboxmin.x; P.x <= bboxmax.x; P.x++) {
-		for (P.y = bboxmin.y; P.y <= bboxmax.y; P.y++) {
-
-			//get the bary_coords for point P
-			vec3f bc_screen = barycentric(pts, P);
-
-			//Check if inside triangle
-			if (bc_screen.x < 0 || bc_screen.y < 0 || bc_screen.z < 0) continue;
-			
-			//Calculating z-value
-			P.z = 0;
-			for (int i = 0; i < 3; i++) {
-				P.z += static_cast<int>(pts[i].z * bc_screen[i]); 
-				// z value is calculated as sum of products : of z-coords of triangle's vertices and coresponding bary_coords
-			}
 
-			//Update z-buffer with pixel closest to the camera(farthest from screen)
-			if (zbuffer[int(P.x + P.y * width)] < P.z) {
-				zbuffer[int(P.x + P.y * width)] = P.z;
+		w0_row += t.w[0].b;	w1_row += t.w[1].b;	w2_row += t.w[2].b;
+		z_row += t.z.b;
+	}
+	return wrote;
+}
 
-				vec2f uv{0,0};
-				// uv coords of the point P is calculated as sum of products : of uv-coords of triangle's vertices and coresponding bary_coords
-				for(int i = 0 ; i < 3 ; i++){
-					uv.x += uvs[i].x * bc_screen[i];
-					uv.y += uvs[i].y * bc_screen[i];
+/*
+	Coarse rejection : walks the part of the triangle's bbox inside clip one row of depth blocks at a time
+
+	--> blocks that lie completely outside one of the edges are skipped
+	--> blocks where even the largest z of the triangle over the block can't beat the coarse depth are skipped
+	--> each run of neighbouring blocks that survived is handed to raster() as one clip rectangle (fewer kernel
+		calls than one per block), if it wrote any depth the blocks of the run are marked dirty
+	the kernels store truncated z, so the bound is truncated too (with a little slack for the rounding of the
+	incremental plane stepping)
+*/
+template <typename Raster>
+inline void for_each_visible_block(const TriangleSetup &t, DepthBuffer &zb, const Tile &clip, Raster &&raster) {
+	const int xmin = std::max(clip.x0, t.xmin), xmax = std::min(clip.x1, t.xmax);
+	const int ymin = std::max(clip.y0, t.ymin), ymax = std::min(clip.y1, t.ymax);
+	const int bs = HiZBuffer::block;
+	HiZBuffer &hiz = zb.hiz();
+
+	for (int by = ymin / bs; by * bs <= ymax; by++) {
+		const int y0 = std::max(ymin, by * bs), y1 = std::min(ymax, by * bs + bs - 1);
+		int run = -1; //first block of the current run of visible blocks
+
+		for (int bx = xmin / bs; ; bx++) {
+			bool visible = false;
+			if (bx * bs <= xmax) {
+				const Tile b = {std::max(xmin, bx * bs), y0, std::min(xmax, bx * bs + bs - 1), y1};
+				visible = t.w[0].max_over(b) >= -1e-9 && t.w[1].max_over(b) >= -1e-9 && t.w[2].max_over(b) >= -1e-9
+						  && !hiz.occluded(bx, by, zb.encode(std::trunc(t.z.max_over(b) + 1e-6)));
+			}
+			if (visible && run < 0) run = bx;
+			if (!visible && run >= 0) {
+				if (raster(Tile{std::max(xmin, run * bs), y0, std::min(xmax, bx * bs - 1), y1})) {
+					for (int k = run; k < bx; k++) hiz.mark_dirty(k, by);
 				}
+				run = -1;
+			}
+			if (bx * bs > xmax) break;
+		}
+	}
+}
 
-				TGAColor color = model->diffuse(uv);
+//Draws a triangle with shader S, picking the widest pixel kernel the cpu supports
+template <Shader S>
+inline void draw_triangle(const S &shader, const typename S::Face &face, const TriangleSetup &t, DepthBuffer &zb, TGAImage &image, const Tile &clip = {0, 0, std::numeric_limits<int>::max(), std::numeric_limits<int>::max()}) {
+	const RasterKernel kernel = raster_kernel();
+	for_each_visible_block(t, zb, clip, [&](const Tile &block) -> bool {
+		switch (kernel) {
+#if RASTER_SIMD
+			case RasterKernel::AVX2:	return raster_avx2(shader, face, t, zb, image, block);
+			case RasterKernel::SSE41:	return raster_sse41(shader, face, t, zb, image, block);
+#endif
+			default:
+				switch (zb.format()) {
+					case DepthBuffer::FLOAT32:	return raster_scalar<S, DepthBuffer::FLOAT32>(shader, face, t, zb, image, block);
+					case DepthBuffer::UNORM24:	return raster_scalar<S, DepthBuffer::UNORM24>(shader, face, t, zb, image, block);
+					default:					return raster_scalar<S, DepthBuffer::UNORM16>(shader, face, t, zb, image, block);
+				}
+		}
+	});
+}
 
-				image.set(static_cast<int>(P.x), static_cast<int>(P.y), color);
+//Depth only pass with the widest depth kernel the cpu supports, nothing but the depth buffer is touched
+//no coarse rejection : testing a block against the coarse level costs about what the depth only kernels spend on
+//the whole block, and a shadow map of one object has next to nothing to reject
+inline void draw_depth(const TriangleSetup &t, DepthBuffer &zb, const Tile &clip = {0, 0, std::numeric_limits<int>::max(), std::numeric_limits<int>::max()}) {
+	switch (raster_kernel()) {
+#if RASTER_SIMD
+		case RasterKernel::AVX2:	depth_avx2(t, zb, clip); return;
+		case RasterKernel::SSE41:	depth_sse41(t, zb, clip); return;
+#endif
+		default:
+			switch (zb.format()) {
+				case DepthBuffer::FLOAT32:	depth_scalar<DepthBuffer::FLOAT32>(t, zb, clip); return;
+				case DepthBuffer::UNORM24:	depth_scalar<DepthBuffer::UNORM24>(t, zb, clip); return;
+				default:					depth_scalar<DepthBuffer::UNORM16>(t, zb, clip); return;
 			}
-		}
 	}
-}
\ No newline at end of file
+}
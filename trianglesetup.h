@@ -0,0 +1,69 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include "geometry.h"
+#include "tiles.h"
+
+//Plane equation f(x,y) = a*x + b*y + c of some value over the screen
+struct Plane {
+	double a = 0, b = 0, c = 0;
+
+	double at(int x, int y) const { return a * x + b * y + c; }
+
+	//largest value over a pixel rectangle, a plane peaks at one of the corners
+	double max_over(const Tile &r) const { return at(r.x0, r.y0) + std::max(0.0, a) * (r.x1 - r.x0) + std::max(0.0, b) * (r.y1 - r.y0); }
+};
+
+/*
+	Triangle setup : everything the raster loop needs, computed once per triangle
+
+	--> w[i] is the barycentric weight of vertex i as a plane over the screen, i.e. the edge function of the
+		edge opposite to vertex i divided by twice the triangle area, a pixel is inside when all three are >= 0
+	--> any value linear in the barycentric coords is a plane too, z = sum z_i*w_i(x,y) so its coefficients
+		are just the weighted sums of the w[i] coefficients (same for u and v)
+	--> the raster loop then only adds the a coefficients when stepping along a row and the b coefficients
+		when stepping to the next row, no per pixel cross products or divisions
+	--> the depth a pixel stores is the z plane at its center truncated once, trunc(sum z_i*w_i). The old per
+		pixel barycentric code truncated every vertex's term before adding them, sum trunc(z_i*w_i), which is
+		0 to 2 lower for the positive depths render() produces : most of depth.tga moved by a level or two, and
+		the few pixels where two faces were that close changed owner in output.tga
+*/
+struct TriangleSetup {
+	Plane w[3];
+	Plane z;
+	Plane u, v;
+	int xmin = 0, ymin = 0, xmax = -1, ymax = -1; //inclusive pixel bbox, clamped to the image
+
+	//returns false for degenerate triangles and triangles completely off screen
+	//reach is how far from a pixel's position its samples lie (multisampling), the bbox grows by the pixels the triangle may only cover with those
+	bool init(const vec3f *pts, const vec2f *uvs, int width, int height, double reach = 0) {
+		const double area = (pts[1].x - pts[0].x) * (pts[2].y - pts[0].y) - (pts[2].x - pts[0].x) * (pts[1].y - pts[0].y);
+		if (std::abs(area) < 1) return false;
+
+		for (int i = 0; i < 3; i++) {
+			const vec3f &p = pts[(i + 1) % 3], &q = pts[(i + 2) % 3];
+			w[i].a = (p.y - q.y) / area;
+			w[i].b = (q.x - p.x) / area;
+			w[i].c = (p.x * q.y - q.x * p.y) / area;
+		}
+
+		z = u = v = Plane();
+		for (int i = 0; i < 3; i++) {
+			z.a += pts[i].z * w[i].a;	z.b += pts[i].z * w[i].b;	z.c += pts[i].z * w[i].c;
+			if (!uvs) continue;
+			u.a += uvs[i].x * w[i].a;	u.b += uvs[i].x * w[i].b;	u.c += uvs[i].x * w[i].c;
+			v.a += uvs[i].y * w[i].a;	v.b += uvs[i].y * w[i].b;	v.c += uvs[i].y * w[i].c;
+		}
+
+		double minx = pts[0].x, maxx = pts[0].x, miny = pts[0].y, maxy = pts[0].y;
+		for (int i = 1; i < 3; i++) {
+			minx = std::min(minx, pts[i].x);	maxx = std::max(maxx, pts[i].x);
+			miny = std::min(miny, pts[i].y);	maxy = std::max(maxy, pts[i].y);
+		}
+		xmin = static_cast<int>(std::max(0.0, minx - reach));
+		ymin = static_cast<int>(std::max(0.0, miny - reach));
+		xmax = static_cast<int>(std::floor(std::min<double>(width - 1, maxx + reach)));
+		ymax = static_cast<int>(std::floor(std::min<double>(height - 1, maxy + reach)));
+		return xmin <= xmax && ymin <= ymax;
+	}
+};
@@ -0,0 +1,141 @@
+#include "vertex.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+static const size_t batch_size = 1024;
+
+bool vertex_single_precision()
+{
+    static const bool single = [] {
+        const char *env = std::getenv("VERTEX_PRECISION");
+        if (!env || std::strcmp(env, "float")) return false;
+        // the float path stands on the SSE overloads of geometry.h, it isn't used if they disagree with the
+        // generic code
+        if (!simd_matches_generic()) {
+            std::cerr << "VERTEX_PRECISION=float : SSE float math doesn't match the generic code, staying in double"
+                      << std::endl;
+            return false;
+        }
+        return true;
+    }();
+    return single;
+}
+
+vec3f clip_to_screen(const VertexStage &vs, const vec4f &clip)
+{
+    const mat4 &p = vs.viewport;
+    double c[4] = {clip[0], clip[1], clip[2], clip[3]};
+
+    if (vs.perspective_divide) {
+        const double w = c[3];
+        c[0] /= w;
+        c[1] /= w;
+        c[2] /= w;
+        c[3] /= w;
+    }
+
+    double s[3];
+    for (int r = 0; r < 3; r++) s[r] = ((p[r][3] * c[3] + p[r][2] * c[2]) + p[r][1] * c[1]) + p[r][0] * c[0];
+
+    return vec3f(s[0], s[1], vs.flip_z ? -s[2] : s[2]);
+}
+
+// One batch of vertices [begin,end), or of ids[begin,end) when given, m is mvp, clip is optional
+static void transform_batch(const VertexStage &vs, const Model &model, vec3f *screen, vec4f *clip,
+                            const size_t begin, const size_t end, const std::uint32_t *ids)
+{
+    const mat4 &m = vs.mvp;
+
+    for (size_t k = begin; k < end; k++) {
+        const size_t i = ids ? ids[k] : k;
+        const vec3f v = model.vert(i);
+
+        // clip = mvp * (v,1), summed from the last column down like dot() does
+        vec4f c;
+        for (int r = 0; r < 4; r++) c[r] = ((m[r][3] + m[r][2] * v.z) + m[r][1] * v.y) + m[r][0] * v.x;
+
+        if (clip) clip[i] = c;
+        screen[i] = clip_to_screen(vs, c);
+    }
+}
+
+// Same as above in single precision, one mat4f32*vec4f32 per matrix
+static void transform_batch_f32(const VertexStage &vs, const Model &model, vec3f *screen, vec4f *clip,
+                                const size_t begin, const size_t end, const std::uint32_t *ids)
+{
+    const mat4f32 m = cast<float>(vs.mvp), p = cast<float>(vs.viewport);
+    const float zsign = vs.flip_z ? -1.0f : 1.0f;
+    const bool soa = model.has_soa();
+
+    for (size_t k = begin; k < end; k++) {
+        const size_t i = ids ? ids[k] : k;
+        vec4f32 v;
+        if (soa) {
+            v = embed<4>(vec3f32(model.pos_x()[i], model.pos_y()[i], model.pos_z()[i]));
+        } else {
+            v = embed<4>(cast<float>(model.vert(i)));
+        }
+
+        vec4f32 c = m * v;
+        if (clip) clip[i] = cast<double>(c);
+        if (vs.perspective_divide) c = c / c[3];
+
+        const vec4f32 s = p * c;
+        screen[i] = vec3f(s[0], s[1], s[2] * zsign);
+    }
+}
+
+static void run_batches(const VertexStage &vs, const Model &model, const std::uint32_t *ids, const size_t n,
+                        std::vector<vec3f> &screen, ThreadPool &pool, std::vector<vec4f> *clip)
+{
+    screen.resize(model.nverts());
+    if (clip) clip->resize(model.nverts());
+    vec4f *clip_out = clip ? clip->data() : nullptr;
+    pool.parallel_for((n + batch_size - 1) / batch_size, [&](size_t b) {
+        const size_t begin = b * batch_size, end = std::min(n, (b + 1) * batch_size);
+        if (vs.single_precision) {
+            transform_batch_f32(vs, model, screen.data(), clip_out, begin, end, ids);
+        } else {
+            transform_batch(vs, model, screen.data(), clip_out, begin, end, ids);
+        }
+    });
+}
+
+void run_vertex_stage(const VertexStage &vs, const Model &model, std::vector<vec3f> &screen, ThreadPool &pool,
+                      std::vector<vec4f> *clip)
+{
+    run_batches(vs, model, nullptr, model.nverts(), screen, pool, clip);
+}
+
+void run_vertex_stage(const VertexStage &vs, const Model &model, std::span<const std::uint32_t> ids,
+                      std::vector<vec3f> &screen, ThreadPool &pool, std::vector<vec4f> *clip)
+{
+    run_batches(vs, model, ids.data(), ids.size(), screen, pool, clip);
+}
+
+const Model &select_lod(const Model &model, const VertexStage &vs, const double max_error)
+{
+    if (max_error <= 0 || model.nlods() == 1) return model;
+
+    // smallest |w| over the bbox corners, they all have to be on the same side of the camera
+    const vec3f &lo = model.bbox_min(), &hi = model.bbox_max();
+    double wmin = 1e30;
+    int sides = 0;
+    for (int i = 0; i < 8; i++) {
+        const vec3f corner(i & 1 ? hi.x : lo.x, i & 2 ? hi.y : lo.y, i & 4 ? hi.z : lo.z);
+        const double w = (vs.mvp * embed<4>(corner))[3];
+        sides |= w > 0 ? 1 : w < 0 ? 2 : 3;
+        wmin = std::min(wmin, std::abs(w));
+    }
+    if (sides == 3 || wmin < 1e-9) return model;
+
+    const double sx = std::abs(vs.viewport[0][0]) * vec3f(vs.mvp[0][0], vs.mvp[0][1], vs.mvp[0][2]).norm();
+    const double sy = std::abs(vs.viewport[1][1]) * vec3f(vs.mvp[1][0], vs.mvp[1][1], vs.mvp[1][2]).norm();
+    const double pixels = std::max(sx, sy) / wmin;  // per model unit
+    for (size_t level = model.nlods() - 1; level > 0; level--)
+        if (model.lod(level).lod_error() * pixels <= max_error) return model.lod(level);
+    return model;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "geometry.h"
+#include "model.h"
+#include "threadpool.h"
+
+/*
+	Post transform vertex stage
+
+	--> the matrices are combined once per frame, then every entry of the model's vertex array is transformed
+		exactly once into a screen space buffer, faces just index into it instead of re-transforming each corner
+		(a shared vertex is used by ~6 faces)
+	--> vertices are processed in fixed size batches spread over the thread pool, the per vertex code is
+		straight line arithmetic on plain doubles so the compiler can vectorize it
+	--> the arithmetic is done in exactly the same order as mat4*vec4 in geometry.h, so the result is bit for bit
+		what the old per corner code produced
+	--> single_precision runs the same transform in float with the SSE mat4f32*vec4f32 from geometry.h, reading the
+		model's SoA position streams when they were built. Screen positions then differ from the double path in
+		the last few bits, so it is opt-in : the VERTEX_PRECISION environment variable set to "float" turns it on
+		for the camera, once simd_matches_generic() has checked the SSE overloads
+	--> the clip space positions (before the division) can be kept too, the clip stage in clip.h needs them for the
+		triangles it has to cut, and maps the new vertices to the screen with clip_to_screen()
+*/
+struct VertexStage
+{
+    mat4 mvp = mat4::identity();       // projection*view*model, combined once per frame
+    mat4 viewport = mat4::identity();  // applied after the perspective division
+    bool perspective_divide = true;
+    bool flip_z = false;  // render() needs screen z negated for its z-test to work
+    bool single_precision = false;
+};
+
+// true when the VERTEX_PRECISION environment variable is "float"
+bool vertex_single_precision();
+
+// Perspective division, viewport and flip_z of one clip space position, what the stage does after mvp
+vec3f clip_to_screen(const VertexStage &vs, const vec4f &clip);
+
+// screen gets the screen position of every model vertex, clip (when given) the clip space position
+void run_vertex_stage(const VertexStage &vs, const Model &model, std::vector<vec3f> &screen, ThreadPool &pool,
+                      std::vector<vec4f> *clip = nullptr);
+// Same for the vertices listed in ids only (the ones of the meshlets left after culling), the other entries are
+// left as they were
+void run_vertex_stage(const VertexStage &vs, const Model &model, std::span<const std::uint32_t> ids,
+                      std::vector<vec3f> &screen, ThreadPool &pool, std::vector<vec4f> *clip = nullptr);
+
+/*
+	Level of detail of model to draw with vs (see Model::build_lods())
+
+	--> the coarsest level whose error stays under max_error pixels on screen, measured where the model's bbox
+		comes closest to the camera : a model unit there spans the viewport scale times the length of mvp's x or y
+		row (the model's scale through the projection) over w
+	--> full detail when max_error is 0 or the bbox reaches behind the camera
+*/
+const Model &select_lod(const Model &model, const VertexStage &vs, const double max_error);
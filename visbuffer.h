@@ -0,0 +1,121 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include "tgaimage.h"
+#include "triangle.h"
+
+/*
+	Visibility buffer for deferred shading
+
+	--> the first pass only resolves visibility : depth goes to the depth buffer as usual and the id of the
+		triangle that won each pixel to this buffer, nothing is sampled or shaded
+	--> the id is stored as a 4 byte "color" (id + 1, 0 where nothing was drawn) in an RGBA image, so the first
+		pass is just draw_triangle() with a FlatShader whose color is the id, and gets the SIMD kernels and coarse
+		depth rejection for free
+	--> barycentrics aren't stored, the winning triangle's setup has them (and every attribute interpolated from
+		them) as planes over the screen, so the second pass evaluates those at the pixel
+	--> the second pass then shades every covered pixel exactly once no matter how often it was overdrawn,
+		and like the raster pass it works on disjoint tiles so it runs in parallel
+*/
+class VisibilityBuffer
+{
+private:
+    TGAImage ids_;
+
+public:
+    VisibilityBuffer(const int width, const int height) : ids_(width, height, TGAImage::RGBA) {}
+
+    // clears the pixels of one tile, each tile of a frame clears its own part before its first pass
+    void clear(const Tile &tile)
+    {
+        const int width = ids_.get_width(), height = ids_.get_height();
+        const int x1 = std::min(tile.x1, width - 1), y1 = std::min(tile.y1, height - 1);
+        for (int y = tile.y0; y <= y1; y++) {
+            std::memset(ids_.buffer() + (tile.x0 + y * width) * 4, 0, (x1 - tile.x0 + 1) * 4);
+        }
+    }
+
+    // target of the first pass
+    TGAImage &ids() { return ids_; }
+
+    // first pass of triangle `id`, writes its depth and id
+    void draw(const std::uint32_t id, const TriangleSetup &t, DepthBuffer &zb, const Tile &tile)
+    {
+        FlatShader::Face face;
+        const std::uint32_t stored = id + 1;
+        std::memcpy(face.color.bgra, &stored, 4);
+        draw_triangle(FlatShader{}, face, t, zb, ids_, tile);
+    }
+
+    // stored ids of row y, id + 1 or 0 where no triangle covered the pixel
+    const std::uint8_t *row(const int y) const { return ids_.buffer() + y * ids_.get_width() * 4; }
+
+    static std::uint32_t stored(const std::uint8_t *row, const int x)
+    {
+        std::uint32_t v;
+        std::memcpy(&v, row + x * 4, 4);
+        return v;
+    }
+};
+
+/*
+	Second pass over one tile : runs the fragment stage once for every covered pixel
+
+	--> each row is walked in runs of pixels won by the same triangle, tris[id] is that triangle and the shader
+		is only bound to it (e.g. mip level selection) when the id changes
+	--> u and v are evaluated from the planes at the start of a run and stepped along it like the raster kernels
+		do, the rounding differs from theirs in the last bits so very rarely a neighbouring texel is picked
+*/
+template <int bpp, Shader S>
+inline void shade_visibility_rows(const VisibilityBuffer &vis, const S &shader, const ShadedTriangle<S> *tris,
+                                  TGAImage &image, const int x0, const int y0, const int x1, const int y1)
+{
+    const int width = image.get_width();
+    std::uint8_t *buffer = image.buffer();
+
+    std::uint32_t last = 0;
+    const ShadedTriangle<S> *t = nullptr;
+    typename S::Bound bound{};
+
+    for (int y = y0; y <= y1; y++) {
+        std::uint8_t *out = buffer + y * width * bpp;
+        const std::uint8_t *ids = vis.row(y);
+        int x = x0;
+        while (x <= x1) {
+            const std::uint32_t stored = VisibilityBuffer::stored(ids, x);
+            if (!stored) {
+                x++;
+                continue;
+            }
+            int end = x + 1;
+            while (end <= x1 && VisibilityBuffer::stored(ids, end) == stored) end++;
+
+            const std::uint32_t id = stored - 1;
+            if (!t || id != last) {
+                t = &tris[id];
+                bound = shader.bind(t->setup, t->face);
+                last = id;
+            }
+            double u = t->setup.u.at(x, y), v = t->setup.v.at(x, y);
+            for (; x < end; x++) {
+                const std::uint32_t c = shader.fragment(bound, x, y, u, v);
+                std::memcpy(out + x * bpp, &c, bpp);
+                u += t->setup.u.a;
+                v += t->setup.v.a;
+            }
+        }
+    }
+}
+
+template <Shader S>
+inline void shade_visibility(const VisibilityBuffer &vis, const S &shader, const ShadedTriangle<S> *tris,
+                             TGAImage &image, const Tile &tile)
+{
+    const int width = image.get_width(), height = image.get_height();
+    const int x1 = std::min(tile.x1, width - 1), y1 = std::min(tile.y1, height - 1);
+    if (image.get_bytespp() == TGAImage::RGBA) {
+        shade_visibility_rows<4>(vis, shader, tris, image, tile.x0, tile.y0, x1, y1);
+    } else {
+        shade_visibility_rows<3>(vis, shader, tris, image, tile.x0, tile.y0, x1, y1);
+    }
+}